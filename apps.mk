@@ -1,12 +1,43 @@
+# This template defines the things we want to add to the makefile for each
+# library that an app compiles from source (see APP_LIB_SOURCES below).
+# $(1) is the name of the app and $(2) is the name of the library.
+# Each source file of the library is copied into the app's folder.
+define APP_LIB_SOURCE_template
+
+APP_LIB_RELS := $$(patsubst libraries/src/$(2)/%.c,apps/$(1)/%.rel, $$(wildcard libraries/src/$(2)/*.c))
+APP_RELS += $$(APP_LIB_RELS)
+TARGETS += $$(APP_LIB_RELS:%.rel=%.c)
+
+apps/$(1)/%.c : libraries/src/$(2)/%.c
+	$$(CP) $$< $$@
+
+endef
+
 # This template defines the things we want to add to the makefile for each app.
+#
+# Besides APP_LIBS, an app's options.mk can define APP_LIB_SOURCES, a list of
+# libraries (without the .lib extension) that are compiled from source together
+# with the app instead of being linked from libraries/lib, and APP_C_FLAGS,
+# extra compiler flags for the app and those libraries.  This is how an app
+# changes the buffer sizes of a library, for example:
+#   APP_LIB_SOURCES := radio_queue
+#   APP_C_FLAGS := -DRADIO_QUEUE_RX_PACKET_COUNT=8 -DRADIO_QUEUE_TX_PACKET_COUNT=4
 define APP_template
 
 APP_RELS := $$(patsubst %.c,%.rel, $$(wildcard apps/$(1)/*.c)) $$(patsubst %.s,%.rel, $$(wildcard apps/$(1)/*.s))
 APP_LIBS := $$(DEFAULT_LIBRARIES)
+APP_LIB_SOURCES :=
+APP_C_FLAGS :=
 -include apps/$(1)/options.mk
+$$(foreach lib, $$(APP_LIB_SOURCES), $$(eval $$(call APP_LIB_SOURCE_template,$(1),$$(lib))))
+# The copies are also matched by the wildcard above once they exist.
+APP_RELS := $$(sort $$(APP_RELS))
+APP_LIBS := $$(filter-out $$(APP_LIB_SOURCES:%=%.lib), $$(APP_LIBS))
 APP_LIBS := $$(foreach lib, $$(APP_LIBS), libraries/lib/$$(lib))
+APP_C_FLAGS_$(1) := $$(APP_C_FLAGS)
 
 RELs += $$(APP_RELS)
+$$(APP_RELS) : C_FLAGS += $$(APP_C_FLAGS_$(1))
 HEXs += apps/$(1)/$(1).hex
 
 apps/$(1)/$(1).hex : $$(APP_RELS) $$(APP_LIBS)
@@ -729,16 +729,18 @@ int doServices(uint8 bWithProtocol)
 }
 
 
+// channel is the channel index = 0...3
 void swap_channel(uint8 channel, uint8 newFSCTRL0)
 {
-	do
+	// goes to IDLE, sets CHANNR and restores the calibration for this channel.
+	if (!radioChannelCacheSelect(channel))
 	{
-		RFST = 4;   //SIDLE
-	} while (MARCSTATE != 0x01);
+		RFST = 1;   //SCAL, first time on this channel
+		while (MARCSTATE != 0x01);
+	}
 
 	// update this, since offset can change based on channel
 	FSCTRL0 = newFSCTRL0;
-	CHANNR = channel;
 	RFST = 2;   //RX
 }
 
@@ -753,7 +755,7 @@ int WaitForPacket(uint16 milliseconds, Dexcom_packet* pkt, uint8 channel)
 	if(channel >= NUM_CHANNELS)
 		return -1;
 	
-	swap_channel(nChannels[channel], fOffset[channel]);
+	swap_channel(channel, fOffset[channel]);
 
 	if(do_verbose)
 		printf("[%lu] starting wait for packet on channel %d(%d) - will wait for %u ms\r\n", start, channel, (int)CHANNR, milliseconds);
@@ -847,6 +849,10 @@ void main()
     radioQueueAllowCrcErrors = 1;
 	// these are reset in radioQueueInit and radioMacInit after our init func was already called
 	MCSM1 = 0;			// after RX go to idle, we don't transmit
+	// calibrate the frequency synthesizer once for each Dexcom channel, so
+	// swap_channel can restore the calibration instead of doing it again.
+	radioChannelCacheInit(nChannels, NUM_CHANNELS);
+	radioChannelCacheCalibrate();
 	
 	while (1)
 	{
@@ -890,6 +896,8 @@ void main()
 			// bootstrap radio again
 			radioMacInit();
 			MCSM1 = 0;			// after RX go to idle, we don't transmit
+			// radioMacInit reloaded the FSCAL registers, and the temperature may have changed.
+			radioChannelCacheCalibrate();
 			radioMacStrobe();
 			
 			// watchdog mode??? this will do a reset?
@@ -1 +1 @@
-APP_LIBS := usb_cdc_acm.lib usb.lib radio_link.lib radio_mac.lib radio_registers.lib wixel.lib random.lib dma.lib
\ No newline at end of file
+APP_LIBS := usb_cdc_acm.lib usb.lib radio_link.lib radio_mac_trace.lib radio_registers.lib wixel.lib random.lib dma.lib
\ No newline at end of file
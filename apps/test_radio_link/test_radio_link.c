@@ -2,6 +2,9 @@
 
 This app lets you test the radio_link library.  This app is mainly intended for
 people who are debugging the library.
+
+It uses radio_mac_trace.lib, so the 't' command prints the timing of the
+radio events that happened since the last 't' command.
 */
 
 #include <wixel.h>
@@ -93,6 +96,24 @@ void handleCommands()
                     radioLinkTxMainLoopIndex, radioLinkTxInterruptIndex, MARCSTATE);
             usbComTxSend(response, responseLength);
         }
+        else if (byte == (uint8)'t')
+        {
+            // Print the trace entries: start time (ms + Timer 4 ticks), event, next state,
+            // ISR latency and handler duration (in Timer 4 ticks of 5.33 us).
+            RADIO_MAC_TRACE_ENTRY XDATA entry;
+            while(usbComTxAvailable() >= 50 && radioMacTraceRead(&entry))
+            {
+                responseLength = sprintf(response, "T: %5u+%3u %d %d lat=%3u dur=%3u\r\n",
+                        entry.ms, entry.ticks, entry.event, entry.state, entry.latency, entry.duration);
+                usbComTxSend(response, responseLength);
+                usbComService();
+            }
+            if (usbComTxAvailable() >= 20)
+            {
+                responseLength = sprintf(response, "T: lost=%u\r\n", radioMacTraceLostCount);
+                usbComTxSend(response, responseLength);
+            }
+        }
         else if (byte >= (uint8)'a' && byte <= (uint8)'g')
         {
             uint8 XDATA * packet = radioLinkTxCurrentPacket();
@@ -75,6 +75,9 @@ BIT framingErrorActive = 0;
 BIT errorOccurredRecently = 0;
 uint8 lastErrorTime;
 
+// Holds data being passed between USB and the radio.
+uint8 XDATA usbRadioBuffer[64];
+
 /** Functions *****************************************************************/
 
 void updateLeds()
@@ -284,16 +287,23 @@ void updateSerialMode()
 void usbToRadioService()
 {
     uint8 signals;
+    uint8 size, available;
 
     // Data
-    while(usbComRxAvailable() && radioComTxAvailable())
+    while((size = usbComRxAvailable()) && (available = radioComTxAvailable()))
     {
-        radioComTxSendByte(usbComRxReceiveByte());
+        if (size > available){ size = available; }
+        if (size > sizeof(usbRadioBuffer)){ size = sizeof(usbRadioBuffer); }
+        usbComRxReceive(usbRadioBuffer, size);
+        radioComTxSend(usbRadioBuffer, size);
     }
 
-    while(radioComRxAvailable() && usbComTxAvailable())
+    while((size = radioComRxAvailable()) && (available = usbComTxAvailable()))
     {
-        usbComTxSendByte(radioComRxReceiveByte());
+        if (size > available){ size = available; }
+        if (size > sizeof(usbRadioBuffer)){ size = sizeof(usbRadioBuffer); }
+        radioComRxReceive(usbRadioBuffer, size);
+        usbComTxSend(usbRadioBuffer, size);
     }
 
     // Control Signals
@@ -1707,16 +1707,18 @@ int doServices(uint8 bWithProtocol)
 }
 
 
+// channel is the channel index = 0...3
 void swap_channel(uint8 channel, uint8 newFSCTRL0)
 {
-	do
+	// goes to IDLE, sets CHANNR and restores the calibration for this channel.
+	if (!radioChannelCacheSelect(channel))
 	{
-		RFST = 4;   //SIDLE
-	} while (MARCSTATE != 0x01);
+		RFST = 1;   //SCAL, first time on this channel
+		while (MARCSTATE != 0x01);
+	}
 
 	// update this, since offset can change based on channel
 	FSCTRL0 = newFSCTRL0;
-	CHANNR = channel;
 	RFST = 2;   //RX
 }
 
@@ -1741,7 +1743,7 @@ int WaitForPacket(uint32 milliseconds, Dexcom_packet* pkt, uint8 channel)
 		return -3;
 	}
 	// set the channel parameters using swap_channel
-	swap_channel(nChannels[channel], fOffset[channel]);
+	swap_channel(channel, fOffset[channel]);
 	// while we haven't reached the delay......
 	while (!milliseconds || (getMs() - start) < milliseconds)
 	{
@@ -1978,7 +1980,10 @@ void main()
 	radioQueueInit();
 	// initialise the Radio Regisers
 	dex_RadioSettings();
-	MCSM0 &= 0x34;			// calibrate every fourth transition to and from IDLE.
+	MCSM0 &= ~0x30;			// never calibrate automatically; swap_channel restores a cached calibration instead.
+	// calibrate the frequency synthesizer once for each Dexcom channel.
+	radioChannelCacheInit(nChannels, NUM_CHANNELS);
+	radioChannelCacheCalibrate();
 	MCSM1 = 0x00;			// after RX go to idle, we don't transmit
 	//MCSM2 = 0x08;
 	MCSM2 = 0x17;			// terminate receiving on drop of carrier, but keep it up when packet quality is good.
@@ -2102,6 +2107,8 @@ void main()
 	Pkts.read = 0;
 	while (1)
 	{
+		// recalibrate each Dexcom channel before scanning; the temperature may have changed since the last cycle.
+		radioChannelCacheCalibrate();
 		scanning_packet = 1;
 		if (get_packet(&Pkts.buffer[Pkts.write])) 
 		{
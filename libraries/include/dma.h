@@ -9,6 +9,7 @@
 #define _DMA_H_
 
 #include <cc2511_map.h>
+#include <cc2511_types.h>
 
 /*! Initializes the DMA1CFGL and DMA1CFGH registers to point
  * to ::dmaConfig.
@@ -20,6 +21,20 @@ void dmaInit(void);
  * transmitting and receiving radio packets. */
 #define DMA_CHANNEL_RADIO  1
 
+/*! This is the number of the DMA channel we have chosen to use as an
+ * alternate channel for receiving radio packets, so that the next
+ * RX transfer can be set up while the current one is happening
+ * (see radioMacRxNext() in radio_mac.h). */
+#define DMA_CHANNEL_RADIO_ALT  2
+
+/*! This is the number of the DMA channel we have chosen to use for
+ * sending bytes on a UART (see uart0TxDmaEnable() in uart0.h). */
+#define DMA_CHANNEL_UART   3
+
+/*! This is the number of the DMA channel we have chosen to use for
+ * copying blocks of memory with dmaCopy(). */
+#define DMA_CHANNEL_COPY   4
+
 /*! This struct consists of 4 DMA config registers
  * for DMA channels 1-4. */
 typedef struct DMA14_CONFIG
@@ -29,14 +44,18 @@ typedef struct DMA14_CONFIG
      * radio packets. */
     volatile DMA_CONFIG radio;
 
-    /*! Config struct for DMA channel 2 (unassigned) */
-    volatile DMA_CONFIG _2;
+    /*! This is the DMA configuration struct for DMA channel 2,
+     * which we have chosen to use as an alternate channel for
+     * receiving radio packets. */
+    volatile DMA_CONFIG radioAlt;
 
-    /*! Config struct for DMA channel 3 (unassigned) */
-    volatile DMA_CONFIG _3;
+    /*! This is the DMA configuration struct for DMA channel 3,
+     * which we have chosen to use for sending bytes on a UART. */
+    volatile DMA_CONFIG uart;
 
-    /*! Config struct for DMA channel 4 (unassigned) */
-    volatile DMA_CONFIG _4;
+    /*! This is the DMA configuration struct for DMA channel 4,
+     * which we have chosen to use for dmaCopy(). */
+    volatile DMA_CONFIG copy;
 } DMA14_CONFIG;
 
 /*! This structure in XDATA holds the configuration options
@@ -47,4 +66,21 @@ typedef struct DMA14_CONFIG
  (or systemInit()) for this struct to work. */
 extern DMA14_CONFIG XDATA dmaConfig;
 
+/*! Copies a block of memory from one place in XDATA to another using
+ * DMA channel 4 (#DMA_CHANNEL_COPY).  This function does not return until
+ * the copy is finished.
+ *
+ * \param dest A pointer to the first byte of the destination block.
+ * \param source A pointer to the first byte of the source block.
+ * \param size The number of bytes to copy.  Must not be zero.
+ *
+ * The two blocks must not overlap.
+ *
+ * For small blocks, copying the bytes with a simple loop is faster
+ * because it takes some time to set up the DMA channel.
+ * This function is meant for blocks of about eight bytes or more.
+ *
+ * This function must not be called from an interrupt. */
+void dmaCopy(uint8 XDATA * dest, const uint8 XDATA * source, uint16 size);
+
 #endif
@@ -0,0 +1,96 @@
+/*! \file packet_pool.h
+ * The <code>packet_pool.lib</code> library manages a pool of packet buffers
+ * in XDATA that can be shared by the radio, UART, and USB code of an app, so
+ * that data can be passed from one of them to another by handing over a
+ * pointer to its buffer instead of copying it.
+ *
+ * A buffer always has exactly one owner: the code that got it from
+ * packetPoolAlloc() or from a function such as radioQueueRxTakePacket(), or
+ * the library it was given to (for example, uart0TxSendPacket() owns the
+ * buffer until uart0TxPacketPending() returns 0).  The owner gives it back to
+ * the pool by calling packetPoolFree() when it is done with it.
+ *
+ * Example: sending the packets received by <code>radio_queue.lib</code> to
+ * UART0 without copying them.
+\code
+uint8 XDATA * packet = 0;
+...
+if (packet == 0 && radioQueueRxCurrentPacket() && packetPoolAvailable())
+{
+    // Give radio_queue a buffer from the pool in exchange for the packet.
+    packet = radioQueueRxTakePacket(packetPoolAlloc());
+    uart0TxSendPacket(packet + 1, packet[0]);
+}
+if (packet != 0 && uart0TxPacketPending() == 0)
+{
+    packetPoolFree(packet);
+    packet = 0;
+}
+\endcode
+ *
+ * The number of buffers and their size can be changed by an app that
+ * compiles this library from source (see APP_LIB_SOURCES in apps.mk), by
+ * defining PACKET_POOL_COUNT and PACKET_POOL_BUFFER_SIZE in its APP_C_FLAGS.
+ *
+ * If an app changes RADIO_QUEUE_PAYLOAD_SIZE in its APP_C_FLAGS and gives pool
+ * buffers to radioQueueRxTakePacket(), it must put packet_pool in its
+ * APP_LIB_SOURCES too, so that the buffers are big enough:
+\code
+APP_LIB_SOURCES := radio_queue packet_pool
+APP_C_FLAGS := -DRADIO_QUEUE_PAYLOAD_SIZE=40
+\endcode
+ * Any file that includes both this header and radio_queue.h fails to compile
+ * if #PACKET_POOL_BUFFER_SIZE is smaller than #RADIO_QUEUE_RX_BUFFER_SIZE.
+ * That catches a wrong APP_C_FLAGS, but not a packet_pool.lib that was built
+ * without them, so do not forget APP_LIB_SOURCES.
+ *
+ * The functions in this library must not be called from interrupts.
+ */
+
+#ifndef _PACKET_POOL_H_
+#define _PACKET_POOL_H_
+
+#include <cc2511_types.h>
+
+/*! The number of buffers that packetPoolInit() puts in the pool. */
+#ifndef PACKET_POOL_COUNT
+#define PACKET_POOL_COUNT 4
+#endif
+
+/*! The size of each buffer in bytes.  The default is big enough to hold a
+ * <code>radio_queue.lib</code> RX packet (#RADIO_QUEUE_RX_BUFFER_SIZE): 22
+ * bytes, or more if RADIO_QUEUE_PAYLOAD_SIZE is defined in APP_C_FLAGS. */
+#ifndef PACKET_POOL_BUFFER_SIZE
+#ifdef RADIO_QUEUE_PAYLOAD_SIZE
+#define PACKET_POOL_BUFFER_SIZE (1 + RADIO_QUEUE_PAYLOAD_SIZE + 2)
+#else
+#define PACKET_POOL_BUFFER_SIZE 22
+#endif
+#endif
+
+#if defined(RADIO_QUEUE_RX_BUFFER_SIZE) && PACKET_POOL_BUFFER_SIZE < RADIO_QUEUE_RX_BUFFER_SIZE
+#error "PACKET_POOL_BUFFER_SIZE is smaller than RADIO_QUEUE_RX_BUFFER_SIZE."
+#endif
+
+/*! Puts the library's buffers in the pool.  This must be called before any of
+ * the other packetPool* functions. */
+void packetPoolInit(void);
+
+/*! \return A buffer of #PACKET_POOL_BUFFER_SIZE bytes that the caller owns
+ * until it gives it to someone else or back to the pool, or 0 if the pool is
+ * empty. */
+uint8 XDATA * packetPoolAlloc(void);
+
+/*! Gives a buffer back to the pool.
+ *
+ * \param buffer A buffer of at least #PACKET_POOL_BUFFER_SIZE bytes that the
+ *   caller owns.  It does not have to be one that came from packetPoolAlloc():
+ *   for example, a packet taken with radioQueueRxTakePacket() can be freed even
+ *   if it is one of the library's own buffers, and it will be used by
+ *   packetPoolAlloc() later. */
+void packetPoolFree(uint8 XDATA * buffer);
+
+/*! \return The number of buffers in the pool. */
+uint8 packetPoolAvailable(void);
+
+#endif
@@ -0,0 +1,120 @@
+/*! \file radio_aggregate.h
+ * The <code>radio_aggregate.lib</code> library packs several small records
+ * into each radio packet.  It is meant for apps that send a lot of short
+ * messages, such as pin states or sensor readings: every radio packet costs a
+ * preamble, a sync word, a CRC, and the time it takes the radio to switch
+ * between RX and TX, so sending a few records together uses much less airtime
+ * than sending each one in its own packet, and causes fewer collisions.
+ * This library depends on <code>radio_queue.lib</code> (or one of its other
+ * builds, such as <code>radio_queue_tdma.lib</code>).
+ *
+ * Each record has a type (from 0 to #RADIO_AGGREGATE_MAX_TYPE) that the
+ * higher-level code can use to tell different kinds of records apart, and
+ * up to #RADIO_AGGREGATE_MAX_RECORD_SIZE bytes of data.  On the air, each
+ * record takes one more byte than its data.
+ *
+ * Records are added to the current TX packet by radioAggregateTxRecord().
+ * The packet is sent when the next record does not fit in it, when
+ * radioAggregateTxFlush() is called, or when its first record has been
+ * waiting for #radioAggregateTxMaxDelay milliseconds.
+ *
+ * Every Wixel that receives the packets must use this library too, because
+ * the packets have a different format than the ones sent by
+ * radioQueueTxSendPacket().
+ *
+ * This library depends on <code>radio_mac.lib</code>, which uses an interrupt.
+ * For this library to work, you must write
+ * <code>include <radio_aggregate.h></code>
+ * in the source file that contains your main() function.
+ */
+
+#ifndef _RADIO_AGGREGATE_H_
+#define _RADIO_AGGREGATE_H_
+
+#include <radio_queue.h>
+
+/*! The highest record type. */
+#define RADIO_AGGREGATE_MAX_TYPE 7
+
+/*! Each record can contain at most this many bytes of data: 18 with the
+ * default #RADIO_QUEUE_PAYLOAD_SIZE. */
+#define RADIO_AGGREGATE_MAX_RECORD_SIZE ((RADIO_QUEUE_PAYLOAD_SIZE - 1) < 31 ? (RADIO_QUEUE_PAYLOAD_SIZE - 1) : 31)
+
+/*! This is a configuration option for the <code>radio_aggregate.lib</code>
+ * library that can be set by higher-level code to trade latency for airtime.
+ * The default value is 20.  Valid values are 0-250.
+ *
+ * A packet that is not full is sent once its first record has been waiting for
+ * this many milliseconds.  If this is 0, every packet is sent the next time
+ * radioAggregateService() is called, so records are only packed together if
+ * they are added between two calls to it.
+ *
+ * This feature depends on getMs() from <code>wixel.lib</code> (see time.h). */
+extern uint8 radioAggregateTxMaxDelay;
+
+/*! Initializes the <code>radio_aggregate.lib</code> library and the
+ * lower-level libraries that it depends on.
+ * This must be called before any of the other radioAggregate* functions. */
+void radioAggregateInit(void);
+
+/*! Sends the current TX packet if it has waited long enough (see
+ * #radioAggregateTxMaxDelay) or if there is no room left in it for a record
+ * with data.
+ * This should be called regularly from the main loop. */
+void radioAggregateService(void);
+
+/*! Adds a record to the current TX packet.  If the record does not fit in the
+ * current packet, the current packet is sent and the record is added to a new
+ * one.
+ *
+ * \param type The type of the record, from 0 to #RADIO_AGGREGATE_MAX_TYPE.
+ * \param length The number of bytes of data in the record, from 0 to
+ *   #RADIO_AGGREGATE_MAX_RECORD_SIZE.
+ *
+ * \return A pointer to where the data of the record should be written, or 0
+ * if the length is too big or all the TX packet buffers are in use.
+ *
+ * The data must be written right away, before the next call to any other
+ * radioAggregate* function.
+ *
+ * Example usage:
+\code
+uint8 XDATA * data = radioAggregateTxRecord(2, 3);
+if (data != 0)
+{
+    data[0] = 'a';
+    data[1] = 'b';
+    data[2] = 'c';
+}
+\endcode
+ */
+uint8 XDATA * radioAggregateTxRecord(uint8 type, uint8 length);
+
+/*! Sends the current TX packet now, if it contains any records. */
+void radioAggregateTxFlush(void);
+
+/*! \return A pointer to the data of the current RX record, or 0 if there is
+ * no RX record available.
+ *
+ * The records are returned in the order they were added by the sender.
+ * When you are done reading the record you should call
+ * radioAggregateRxDoneWithRecord() to advance to the next record. */
+uint8 XDATA * radioAggregateRxCurrentRecord(void);
+
+/*! \return The type of the current RX record.
+ *
+ * This should only be called if radioAggregateRxCurrentRecord() recently
+ * returned a non-zero pointer. */
+uint8 radioAggregateRxCurrentType(void);
+
+/*! \return The number of bytes of data in the current RX record.
+ *
+ * This should only be called if radioAggregateRxCurrentRecord() recently
+ * returned a non-zero pointer. */
+uint8 radioAggregateRxCurrentLength(void);
+
+/*! Advances to the next RX record.  The radio packet that held the record is
+ * given back to <code>radio_queue.lib</code> after its last record. */
+void radioAggregateRxDoneWithRecord(void);
+
+#endif
@@ -20,6 +20,10 @@
  *
  * This library also supports sending 8 control signals to the other Wixel
  * and receiving 8 control signals from the other Wixel.
+ *
+ * The stream of bytes can be divided into several independent channels
+ * (see radioComChannelTxSend()).  Channel 0 is the stream used by
+ * radioComTxSendByte() and radioComRxReceiveByte().
  */
 
 #ifndef _RADIO_COM_H_
@@ -27,6 +31,11 @@
 
 #include <radio_link.h>
 
+/*! The number of independent byte streams (channels) supported by
+ * <code>radio_com.lib</code>, including channel 0.
+ * See radioComChannelTxSend(). */
+#define RADIO_COM_CHANNEL_COUNT 4
+
 /*! Initializes the <code>radio_com.lib</code> library and the
  * lower-level libraries that it depends on.
  * This must be called before any of the other radioCom* functions. */
@@ -52,6 +61,34 @@ void radioComInit(void);
  * using the control signals, you should leave this bit at 0. */
 extern BIT radioComRxEnforceOrdering;
 
+/*! This is a configuration option for the <code>radio_com.lib</code> library that
+ * can be set by higher-level code to trade latency for efficiency.
+ * The default value is 1.
+ *
+ * A packet that is not full will only be sent when the radio is not busy
+ * sending earlier packets and the packet contains at least this many bytes.
+ * Full packets (#RADIO_LINK_PAYLOAD_SIZE bytes) are always sent right away.
+ *
+ * The default value sends data as soon as possible, which is good for interactive
+ * applications.  Setting this to #RADIO_LINK_PAYLOAD_SIZE means that only full
+ * packets are sent, which gives the highest throughput for applications that send
+ * a lot of data, such as data loggers.  In that case, you should also set
+ * #radioComTxMaxDelay or call radioComTxFlush() so that the last few bytes
+ * eventually get sent.  */
+extern uint8 radioComTxMinFill;
+
+/*! This is a configuration option for the <code>radio_com.lib</code> library that
+ * can be set by higher-level code to put a bound on latency.
+ * The default value is 0, which disables this feature.
+ * Valid values are 0-250.
+ *
+ * When this is non-zero, a packet that is not full will be sent once the first
+ * byte in it has been waiting for this many milliseconds, regardless of
+ * #radioComTxMinFill.  This only works if radioComTxService() is called regularly.
+ *
+ * This feature depends on getMs() from <code>wixel.lib</code> (see time.h). */
+extern uint8 radioComTxMaxDelay;
+
 /*! \return The number of bytes in the RX buffer.
  *
  * You can use this function to see if any bytes have been received, and then
@@ -68,8 +105,23 @@ uint8 radioComRxAvailable(void);
  * radioComRxAvailable(). */
 uint8 radioComRxReceiveByte(void);
 
+/*! Reads the specified number of bytes from the RX buffer and stores them in memory.
+ *
+ * \param buffer The buffer to store the data in.
+ * \param size The number of bytes to read.
+ *
+ * This is a non-blocking function: you must call radioComRxAvailable() before calling
+ * this function and be sure not to read too many bytes.
+ * The \p size parameter should not exceed the last value returned by
+ * radioComRxAvailable().
+ *
+ * This is faster than calling radioComRxReceiveByte() \p size times.
+ * Large spans are copied using DMA (see dmaCopy() in dma.h). */
+void radioComRxReceive(uint8 XDATA * buffer, uint8 size);
+
 /*! This function must be called regularly if you want to send data
- * or control signals to the other Wixel. */
+ * or control signals to the other Wixel, or receive data on channels 1 and up
+ * (see radioComChannelRxAvailable()). */
 void radioComTxService(void);
 
 /*! \return The number of bytes available in the TX buffer. */
@@ -87,6 +139,29 @@ uint8 radioComTxAvailable(void);
  * If you call this function, you must also call radioComTxService() regularly. */
 void radioComTxSendByte(uint8 byte);
 
+/*! Adds bytes to the TX buffer, which means they will be eventually
+ * sent to the other Wixel over the radio.
+ *
+ * \param buffer A pointer to the bytes to send.
+ * \param size The number of bytes to send.
+ *
+ * This is a non-blocking function: you must call radioComTxAvailable() before calling this
+ * function and be sure not to add too many bytes to the buffer.
+ * The \p size parameter should not exceed the last value returned by radioComTxAvailable().
+ *
+ * This is faster than calling radioComTxSendByte() \p size times.
+ * Large spans are copied using DMA (see dmaCopy() in dma.h).
+ *
+ * If you call this function, you must also call radioComTxService() regularly. */
+void radioComTxSend(const uint8 XDATA * buffer, uint8 size);
+
+/*! Sends all the bytes that have been added to the TX buffer as soon as possible,
+ * even if the current packet is not full.
+ *
+ * You can call this at the end of a message or record to make sure it is not
+ * held back by #radioComTxMinFill or #radioComTxMaxDelay. */
+void radioComTxFlush(void);
+
 /*! \param controlSignals The state of the eight virtual TX control signals.
  *   Each bit represents a different control signal.
  *
@@ -113,4 +188,74 @@ void radioComTxControlSignals(uint8 controlSignals);
  * signals) is determined by higher-level code. */
 uint8 radioComRxControlSignals(void);
 
+/*! \return The number of bytes that can be read from the given channel
+ * with radioComChannelRxReceive().
+ *
+ * \param channel The channel number, from 0 to #RADIO_COM_CHANNEL_COUNT - 1.
+ *
+ * For channel 0, this is the same as radioComRxAvailable().
+ *
+ * Each channel has its own RX buffer, which holds two packets' worth of data.
+ * The other Wixel only sends data for channels 1 and up when there is room
+ * for it in the buffer, so unread data on those channels never prevents data
+ * on other channels from being received.
+ *
+ * Channel 0 is not flow-controlled this way, so that it keeps working with
+ * older versions of this library.  Until the other Wixel uses another
+ * channel, channel 0 data is read straight from the radio_link packets, and
+ * after that it is copied to its own buffer.  In both cases, if the
+ * higher-level code stops reading channel 0, the other channels will
+ * eventually stop too, because the packets for all the channels arrive in
+ * order over the same link.
+ *
+ * To tell the other Wixel how much room there is, this library sends it
+ * credit packets from radioComTxService(), so if you read channels 1 and up
+ * you must call radioComTxService() regularly. */
+uint8 radioComChannelRxAvailable(uint8 channel);
+
+/*! Reads the specified number of bytes from the given channel and stores them in memory.
+ *
+ * \param channel The channel number, from 0 to #RADIO_COM_CHANNEL_COUNT - 1.
+ * \param buffer The buffer to store the data in.
+ * \param size The number of bytes to read.  This should not exceed the last
+ *   value returned by radioComChannelRxAvailable() for the same channel. */
+void radioComChannelRxReceive(uint8 channel, uint8 XDATA * buffer, uint8 size);
+
+/*! \return The number of bytes that can be added to the given channel
+ * with radioComChannelTxSend().
+ *
+ * \param channel The channel number, from 0 to #RADIO_COM_CHANNEL_COUNT - 1.
+ *
+ * For channel 0, this is the same as radioComTxAvailable().
+ * Every other channel has room for one packet
+ * (#RADIO_LINK_PAYLOAD_SIZE bytes), which is sent once the other Wixel has
+ * room for it in its RX buffer for that channel
+ * (see radioComChannelRxAvailable()).
+ * At startup and after the other Wixel is reset, the two Wixels exchange
+ * credit packets before data for these channels flows normally; until then,
+ * at most one RX buffer's worth of data is sent on each channel. */
+uint8 radioComChannelTxAvailable(uint8 channel);
+
+/*! Adds bytes to the TX buffer of the given channel, which means they will be
+ * eventually sent to the same channel on the other Wixel.
+ *
+ * \param channel The channel number, from 0 to #RADIO_COM_CHANNEL_COUNT - 1.
+ * \param buffer A pointer to the bytes to send.
+ * \param size The number of bytes to send.  This should not exceed the last
+ *   value returned by radioComChannelTxAvailable() for the same channel.
+ *
+ * Channels let you send several independent streams of bytes (e.g. telemetry
+ * and a command console) over the same link without having to mix them
+ * together yourself.
+ * When several channels have data to send, radioComTxService() gives the
+ * packets to them in turn.  Partial packets are sent according to the same
+ * policy as channel 0 (see #radioComTxMinFill and #radioComTxMaxDelay).
+ *
+ * Channel 0 uses the same packets as older versions of this library.
+ * The other channels use payload types 8 and up, which older versions of this
+ * library do not understand, so only use them if both Wixels support channels.
+ *
+ * If you call this function, you must also call radioComTxService() regularly. */
+void radioComChannelTxSend(uint8 channel, const uint8 XDATA * buffer, uint8 size);
+
 #endif /* RADIO_COM_H_ */
@@ -16,6 +16,29 @@
  * different times then the regular data, you would need to replace this library with
  * something more complicated that keeps track of different streams and schedules them.
  *
+ * By default, only one data packet is in flight at a time: every packet must be
+ * acknowledged before the next one is sent.  If you link your app with
+ * <code>radio_link_window.lib</code> instead of <code>radio_link.lib</code>,
+ * up to 4 packets from the TX queue are sent back-to-back and the other Wixel
+ * acknowledges them selectively, so only lost packets get retransmitted.  This
+ * gives much higher throughput.  The API is the same for both libraries, but
+ * both Wixels must use the same one.
+ *
+ * If you link your app with <code>radio_link_adapt.lib</code> instead, the
+ * two Wixels also adapt the link to its quality.  Every packet tells the other
+ * Wixel how strong its signal is, and each Wixel turns down its transmit power
+ * when there is plenty of margin to save energy.  The Wixels also agree on a
+ * PHY profile (see radioSetProfile()): they switch to a faster data rate when
+ * the link is good and to a slower, more robust one when too many packets are
+ * lost.  Both Wixels must use <code>radio_link_adapt.lib</code>, and the
+ * statistics it uses are available in #radioLinkAdaptRssi and the variables
+ * after it.
+ *
+ * The time this library waits for an acknowledgment before retransmitting
+ * adapts to the measured round-trip time of the link, and grows exponentially
+ * while retransmissions keep failing.  It uses getMs() from
+ * <code>wixel.lib</code> to measure the round-trip time.
+ *
  * This library depends on <code>radio_mac.lib</code>, which uses an interrupt.
  * For this library to work, you must write
  * <code>include <radio_link.h></code>
@@ -30,8 +53,32 @@
 
 /*! Each packet can contain at most 18 bytes of payload.
  * This limit is imposed by the <code>radio_link.lib</code> library,
- * not the CC2511. */
+ * not the CC2511.
+ *
+ * This, and the number of packet buffers (RADIO_LINK_RX_PACKET_COUNT and
+ * RADIO_LINK_TX_PACKET_COUNT, which default to 3 and 16) can be changed by an
+ * app that compiles this library from source.  To do that, put these lines in
+ * the app's <code>options.mk</code>:
+ *
+\code
+APP_LIB_SOURCES := radio_link radio_com
+APP_C_FLAGS := -DRADIO_LINK_PAYLOAD_SIZE=30 -DRADIO_LINK_TX_PACKET_COUNT=8
+\endcode
+ *
+ * The RX count must be at least 3 and the TX count must be a power of 2.
+ * If you change the payload size or the TX count, the libraries your app uses
+ * that are built on this one (such as <code>radio_com.lib</code> and
+ * <code>radio_message.lib</code>) must be in APP_LIB_SOURCES too. */
+#ifndef RADIO_LINK_PAYLOAD_SIZE
 #define RADIO_LINK_PAYLOAD_SIZE 18
+#endif
+
+/*! The number of TX packet buffers.  At most one less than this can be
+ * queued at once (see radioLinkTxAvailable()).
+ * See #RADIO_LINK_PAYLOAD_SIZE for how to change it. */
+#ifndef RADIO_LINK_TX_PACKET_COUNT
+#define RADIO_LINK_TX_PACKET_COUNT 16
+#endif
 
 /*! Each packet has a "Payload Type" attached to it,
  * which is a number between 0 and #RADIO_LINK_MAX_PAYLOAD_TYPE.
@@ -162,7 +209,12 @@ uint8 XDATA * radioLinkRxCurrentPacket(void);  // returns 0 if no packet is avai
 uint8 radioLinkRxCurrentPayloadType(void);
 
 /*! Frees the current RX packet so that you can advance to processing
- * the next one.  See the radioLinkRxCurrentPacket() documentation for details. */
+ * the next one.  See the radioLinkRxCurrentPacket() documentation for details.
+ *
+ * Every packet this library sends tells the other Wixel how many data
+ * packets it can accept, and the other Wixel does not send data we have no
+ * room for.  If we had told it that we had no room, calling this function
+ * makes us tell it that there is room now. */
 void radioLinkRxDoneWithPacket(void);
 
 /*! \return 1 if a connection to another Wixel has been established.
@@ -176,4 +228,30 @@ BIT radioLinkConnected(void);
  * Higher-level code may check this bit and clear it. */
 extern volatile BIT radioLinkActivityOccurred;
 
+/*! The average RSSI (in dBm) of the packets received from the other Wixel,
+ * or 0 if nothing has been received yet.
+ * Only available in <code>radio_link_adapt.lib</code>. */
+extern volatile int8 radioLinkAdaptRssi;
+
+/*! The average Link Quality Indicator (see radioLqi()) of the packets received
+ * from the other Wixel.
+ * Only available in <code>radio_link_adapt.lib</code>. */
+extern volatile uint8 radioLinkAdaptLqi;
+
+/*! The RSSI (in dBm, in steps of 4 dB) of our packets, as reported by the
+ * other Wixel, or 0 if it has not reported it yet.
+ * Only available in <code>radio_link_adapt.lib</code>. */
+extern volatile int8 radioLinkAdaptPeerRssi;
+
+/*! A moving average of the fraction of packets that were lost or corrupted,
+ * from 0 to 255.  The link switches to a slower PHY profile when this goes
+ * above 96 at full transmit power.
+ * Only available in <code>radio_link_adapt.lib</code>. */
+extern volatile uint8 radioLinkAdaptErrorRate;
+
+/*! The current transmit power level, from 0 (the highest power, the same
+ * as radioRegistersInit() uses) to 5 (about 20 dB lower).
+ * Only available in <code>radio_link_adapt.lib</code>. */
+extern volatile uint8 radioLinkAdaptPowerLevel;
+
 #endif
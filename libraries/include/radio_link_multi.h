@@ -0,0 +1,135 @@
+/*! \file radio_link_multi.h
+ * The <code>radio_link_multi.lib</code> library provides reliable, ordered
+ * delivery and reception of a series of data packets between this Wixel
+ * and several other Wixels on the same frequency, such as a base station
+ * and a group of remote sensor nodes.
+ *
+ * It uses the same Ping/ACK/NAK/Reset protocol as <code>radio_link.lib</code>
+ * (see radio_link.h), but every packet also carries the address of the
+ * Wixel that should receive it and the address of the Wixel that sent it.
+ * This library keeps a separate sequence bit, retry counter and reset state
+ * for each peer it talks to, and a separate TX queue for each peer.
+ * When several peers have data waiting, the queues are served round-robin.
+ *
+ * Every Wixel on the channel must use this library and must have a different
+ * address (#param_radio_address).
+ *
+ * Peers are added to the peer table the first time a packet is queued for
+ * them or received from them.  At most #RADIO_LINK_MULTI_MAX_PEERS peers can
+ * be in the table, and peers are never removed from it.  Packets from other
+ * Wixels are ignored.  Packets addressed to other Wixels are discarded by the
+ * radio's address filter (see radioMacAddressFilter()) without interrupting
+ * the CPU.
+ *
+ * This library depends on <code>radio_mac.lib</code>, which uses an interrupt.
+ * For this library to work, you must write
+ * <code>include <radio_link_multi.h></code>
+ * in the source file that contains your main() function.
+ */
+
+#ifndef _RADIO_LINK_MULTI
+#define _RADIO_LINK_MULTI
+
+#include <cc2511_types.h>
+#include <radio_mac.h>
+
+/*! Each packet can contain at most 18 bytes of payload, the same as
+ * <code>radio_link.lib</code>. */
+#define RADIO_LINK_MULTI_PAYLOAD_SIZE 18
+
+/*! Each packet has a "Payload Type" attached to it,
+ * which is a number between 0 and #RADIO_LINK_MULTI_MAX_PAYLOAD_TYPE. */
+#define RADIO_LINK_MULTI_MAX_PAYLOAD_TYPE 15
+
+/*! The maximum number of peers this Wixel can talk to. */
+#define RADIO_LINK_MULTI_MAX_PEERS 4
+
+/*! Defines the frequency to use.  Valid values are from
+ * 0 to 255.  (This is a Wixel App parameter; the user can set
+ * it using the Wixel Configuration Utility.) */
+extern int32 CODE param_radio_channel;
+
+/*! The address of this Wixel.  Valid values are from 0 to 255.
+ * Every Wixel on the same channel must have a different address.
+ * (This is a Wixel App parameter; the user can set
+ * it using the Wixel Configuration Utility.) */
+extern int32 CODE param_radio_address;
+
+/*! This bit is set to 1 in an interrupt whenever a reset packet is received
+ * from any peer.  The address of the peer is stored in
+ * #radioLinkMultiResetPacketAddress.  The higher-level code should set
+ * it to zero when it uses this information.
+ * See #radioLinkResetPacketReceived in radio_link.h for details. */
+extern volatile BIT radioLinkMultiResetPacketReceived;
+
+/*! The address of the peer that sent the last reset packet. */
+extern volatile uint8 radioLinkMultiResetPacketAddress;
+
+/*! Initializes the <code>radio_link_multi.lib</code> library and the lower-level
+ *  libraries that it depends on.  This must be called before
+ *  any other functions in the library. */
+void radioLinkMultiInit(void);
+
+/*! \return The number of TX packet buffers that are currently free in the
+ * queue for the given peer, or 0 if the peer table is full.
+ *
+ * \param address The address of the peer. */
+uint8 radioLinkMultiTxAvailable(uint8 address);
+
+/*! \return The number of TX packet buffers that are currently busy in the
+ * queue for the given peer.
+ *
+ * \param address The address of the peer. */
+uint8 radioLinkMultiTxQueued(uint8 address);
+
+/*! \return A pointer to the current TX packet for the given peer, or 0 if
+ * no packet is available.
+ *
+ * \param address The address of the peer.
+ *
+ * The packet has the same format as in radioLinkTxCurrentPacket():
+ * write the payload length to offset 0 and the data starting at offset 1,
+ * then call radioLinkMultiTxSendPacket() with the same address. */
+uint8 XDATA * radioLinkMultiTxCurrentPacket(uint8 address);
+
+/*! Sends the current TX packet for the given peer.
+ *
+ * \param address The address of the peer.  radioLinkMultiTxCurrentPacket()
+ *   must have recently returned a non-zero pointer for this address.
+ * \param payloadType A number between 0 and #RADIO_LINK_MULTI_MAX_PAYLOAD_TYPE
+ *   that will be attached to the packet. */
+void radioLinkMultiTxSendPacket(uint8 address, uint8 payloadType);
+
+/*! \return A pointer to the current RX packet, or 0 if there is no RX packet
+ * available.  Packets from all peers are returned in the order they were
+ * received.
+ *
+ * The RX packet has the same format as the TX packet: the length of the
+ * payload is at offset 0 and the data starts at offset 1.
+ *
+ * When you are done reading the packet you should call
+ * radioLinkMultiRxDoneWithPacket() to advance to the next packet. */
+uint8 XDATA * radioLinkMultiRxCurrentPacket(void);
+
+/*! \return The payload type of the current RX packet.
+ *
+ * This should only be called if radioLinkMultiRxCurrentPacket() recently
+ * returned a non-zero pointer. */
+uint8 radioLinkMultiRxCurrentPayloadType(void);
+
+/*! \return The address of the peer that sent the current RX packet.
+ *
+ * This should only be called if radioLinkMultiRxCurrentPacket() recently
+ * returned a non-zero pointer. */
+uint8 radioLinkMultiRxCurrentAddress(void);
+
+/*! Frees the current RX packet so that you can advance to processing
+ * the next one. */
+void radioLinkMultiRxDoneWithPacket(void);
+
+/*! The library will set this bit to 1 whenever it receives a packet that
+ * has payload data in it or sends a packet.
+ * Higher-level code may check this bit and clear it. */
+extern volatile BIT radioLinkMultiActivityOccurred;
+
+#endif
@@ -36,6 +36,20 @@
 #define RADIO_MAC_EVENT_RX_TIMEOUT          32
 /*! See the documentation for radioMacEventHandler(). */
 #define RADIO_MAC_EVENT_STROBE              33
+/*! See the documentation for radioMacEventHandler(). */
+#define RADIO_MAC_EVENT_TX_BUSY             34
+
+/*! Address filtering mode for radioMacAddressFilter(): Accept all packets. */
+#define RADIO_MAC_ADDRESS_CHECK_OFF              0
+/*! Address filtering mode for radioMacAddressFilter(): Only accept packets
+ * sent to this device's address. */
+#define RADIO_MAC_ADDRESS_CHECK_NO_BROADCAST     1
+/*! Address filtering mode for radioMacAddressFilter(): Accept packets
+ * sent to this device's address or to address 0x00. */
+#define RADIO_MAC_ADDRESS_CHECK_BROADCAST_00     2
+/*! Address filtering mode for radioMacAddressFilter(): Accept packets
+ * sent to this device's address, to address 0x00, or to address 0xFF. */
+#define RADIO_MAC_ADDRESS_CHECK_BROADCAST_00_FF  3
 
 /*! Initializes the radio.
  * This involves calling radioRegistersInit().
@@ -58,6 +72,126 @@ void radioMacInit(void);
  * code to so it can use the new data. */
 void radioMacStrobe(void);
 
+/*! This is a configuration option for the calibration of the radio's
+ * frequency synthesizer.
+ * The default value is 0.
+ *
+ * The frequency synthesizer must be calibrated regularly, and each calibration
+ * takes about 800&nbsp;us, during which the radio can not send or receive.
+ * When this bit is 0, the radio calibrates every time it goes from IDLE to
+ * RX or TX (MCSM0.FS_AUTOCAL = 01), which happens after every RX timeout.
+ *
+ * When this bit is 1, the library turns that off and only calibrates when
+ * one of the following is true:
+ * - The number of radio events since the last calibration has reached
+ *   #radioMacCalibrationEventInterval.
+ * - The number of milliseconds since the last calibration has reached
+ *   #radioMacCalibrationMsInterval.
+ * - radioMacCalibrateSoon() has been called.
+ * - radioMacCalibrationTemperatureService() detected a temperature change.
+ *
+ * The calibration happens the next time the library starts up the radio
+ * after one of these events.  If you set this bit, make sure you call
+ * radioMacCalibrateSoon() whenever you change the CHANNR register. */
+extern BIT radioMacCalibrationScheduled;
+
+/*! This is a configuration option for the calibration of the radio's
+ * frequency synthesizer: the number of radio events between calibrations.
+ * The default value is 0, which disables this rule.
+ * This only has an effect if #radioMacCalibrationScheduled is 1. */
+extern uint8 radioMacCalibrationEventInterval;
+
+/*! This is a configuration option for the calibration of the radio's
+ * frequency synthesizer: the number of milliseconds between calibrations.
+ * The default value is 1000.
+ * A value of 0 disables this rule.
+ * This only has an effect if #radioMacCalibrationScheduled is 1.
+ *
+ * This rule depends on getMs() from <code>wixel.lib</code> (see time.h). */
+extern uint16 radioMacCalibrationMsInterval;
+
+/*! Requests a calibration of the frequency synthesizer the next time the
+ * library starts up the radio.  This works even if
+ * #radioMacCalibrationScheduled is 0, so it can be used when something else
+ * (such as radioChannelCacheSelect()) turned off automatic calibration.
+ *
+ * Call this after changing the frequency (e.g. the CHANNR register) or other
+ * radio settings that require calibration. */
+void radioMacCalibrateSoon(void);
+
+/*! This is a configuration option for radioMacCalibrationTemperatureService():
+ * the change in the temperature sensor reading (in ADC counts) that causes a
+ * calibration.  The default value is 40, which is roughly 10 degrees Celsius.
+ * A value of 0 disables this rule. */
+extern uint16 radioMacCalibrationTemperatureDrift;
+
+/*! Reads the CC2511's temperature sensor with the ADC (at most once per second)
+ * and calls radioMacCalibrateSoon() if the temperature has changed by
+ * #radioMacCalibrationTemperatureDrift since the last calibration it requested.
+ *
+ * This function should be called regularly from the main loop if you want the
+ * radio to be calibrated when the temperature changes.
+ * It uses <code>adc.lib</code>, which is not needed if you do not call this function. */
+void radioMacCalibrationTemperatureService(void);
+
+/*! The maximum number of channels that radioMacHopInit() supports. */
+#define RADIO_MAC_HOP_MAX_CHANNELS 16
+
+/*! Sets up the channel hopping functions for a set of \p count channels.
+ *
+ * The channels are spread evenly over the whole band, starting at
+ * \p firstChannel (for example, with 4 channels and a first channel of 10, the
+ * channels are 10, 74, 138, and 202).  They are put in a pseudo-random order
+ * that only depends on \p firstChannel and \p count, so every Wixel that
+ * calls this function with the same arguments gets the same hop sequence.
+ * Each channel is identified by its index in that sequence.
+ *
+ * The statistics and the blacklist are cleared.
+ *
+ * This function also sets #radioMacCalibrationScheduled to 1, because the
+ * channel cache turns off automatic calibration.
+ *
+ * The channel hopping functions are used by higher-level libraries such as
+ * <code>radio_queue_tdma.lib</code>, which decide when to hop. */
+void radioMacHopInit(uint8 firstChannel, uint8 count);
+
+/*! \return The channel number (CHANNR value) for the given hop index. */
+uint8 radioMacHopChannel(uint8 index);
+
+/*! Moves the radio to the channel with the given hop index.
+ *
+ * The first time the radio moves to a channel, the frequency synthesizer is
+ * calibrated (see radioMacCalibrateSoon()).  The calibration is kept in the
+ * channel cache of <code>radio_registers.lib</code> (see
+ * radioChannelCacheSelect()), so later hops do not need to calibrate.
+ *
+ * This function will only work if it is called from radioMacEventHandler(). */
+void radioMacHopTo(uint8 index);
+
+/*! Records whether a packet on the current channel was received successfully.
+ * This updates #radioMacHopErrorRate and #radioMacHopBlacklist.
+ * Higher-level code should call this from radioMacEventHandler() when it
+ * receives a packet (or a packet it expected did not arrive). */
+void radioMacHopRecord(uint8 success);
+
+/*! \return 0 if the channel with the given hop index is blacklisted,
+ * 1 otherwise. */
+uint8 radioMacHopUsable(uint8 index);
+
+/*! The error rate of each channel in the hop sequence, from 0 to 255.
+ * This is a moving average of the results passed to radioMacHopRecord(). */
+extern uint8 XDATA radioMacHopErrorRate[RADIO_MAC_HOP_MAX_CHANNELS];
+
+/*! A bit map of the channels in the hop sequence that are blacklisted.
+ * Bit n is 1 if the channel with hop index n is blacklisted.
+ *
+ * A channel is blacklisted when its error rate goes above 96 and
+ * is used again when its error rate drops below 48.  The error rate of a
+ * blacklisted channel slowly decreases every time radioMacHopTo() moves to it,
+ * so it will eventually be tried again.  At most half of the channels can be
+ * blacklisted at the same time. */
+extern uint16 radioMacHopBlacklist;
+
 /*! Shutdown the radio in preparation for sleep.
  *
  * This function sets a shutdown bit then triggers the strobe
@@ -100,11 +234,42 @@ void radioMacTx(uint8 XDATA * packet);
  */
 void radioMacRx(uint8 XDATA * packet, uint8 timeout);
 
+/*! Turns off the radio (puts it in the IDLE state) to save power.
+ * The radio stays off until radioMacStrobe() is called, and then
+ * radioMacEventHandler() will be called with #RADIO_MAC_EVENT_STROBE.
+ *
+ * This function will only work if it is called from radioMacEventHandler(). */
+void radioMacIdle(void);
+
+/*! Sets up the buffer for the packet after the one that the radio is about
+ * to receive, so that the radio can go back to RX mode immediately after
+ * receiving a packet, without missing packets that arrive right after it.
+ *
+ * \param packet A pointer to the location to store the next packet.
+ *
+ * This function will only work if it is called from radioMacEventHandler(),
+ * and it only applies to that call of radioMacEventHandler().  It should be
+ * called after radioMacRx() (or in place of it, as described below).
+ *
+ * When the next packet is received, the DMA transfer for the packet after it
+ * is started and the radio is put back in RX mode <b>before</b>
+ * radioMacEventHandler() is called with #RADIO_MAC_EVENT_RX.
+ * In that call, the radio is already receiving into the buffer passed to this function,
+ * so radioMacEventHandler() should not call radioMacRx() if it wants to keep
+ * receiving; it can just call radioMacRxNext() again with another buffer.
+ * If it calls radioMacRx() or radioMacTx() instead, the radio is stopped
+ * (losing any packet it was receiving) and restarted the normal way.
+ *
+ * This uses DMA channel 2 (#DMA_CHANNEL_RADIO_ALT) in addition to DMA channel 1.
+ * The RX timeout is not restarted for the next packet, so this is intended for
+ * receiving with no timeout. */
+void radioMacRxNext(uint8 XDATA * packet);
+
 /*! This is a callback function that should be defined by higher-level code.
  *
  * This function is called in the RF ISR whenever a radio-related event happens.
- * This function should decide what the radio will do next by calling either
- * radioMacTx() or radioMacRx().
+ * This function should decide what the radio will do next by calling
+ * radioMacTx(), radioMacRx(), or radioMacIdle().
  *
  * \param event The event that just happened.  This will be one of:
  * - #RADIO_MAC_EVENT_TX: The radio just finished transmitting a packet.
@@ -112,6 +277,11 @@ void radioMacRx(uint8 XDATA * packet, uint8 timeout);
  * - #RADIO_MAC_EVENT_RX_TIMEOUT: The radio was listening for a packet and
  *   nothing was received within the timeout period.
  * - #RADIO_MAC_EVENT_STROBE: The function radioMacStrobe() was called.
+ * - #RADIO_MAC_EVENT_TX_BUSY: The handler called radioMacTx(), but
+ *   #radioMacListenBeforeTalk is 1 and the channel was busy, so the packet
+ *   was not sent.  Typically the handler should call radioMacRx() with a
+ *   short random timeout and try again later.  This event only happens if
+ *   #radioMacListenBeforeTalk is 1.
  *
  * Note: Not every call to radioMacStrobe() results in a call to
  * radioMacEventHandler with argument RADIO_MAC_EVENT_STROBE.
@@ -126,6 +296,10 @@ void radioMacEventHandler(uint8 event);
  * An RX overflow is an error that indicates that incoming data was
  * not read from the radio fast enough.
  * This should not happen.
+ *
+ * The library automatically gets the radio out of the RX_OVERFLOW state
+ * and starts receiving again, so the only consequence is that the packet
+ * being received is lost.
  */
 extern volatile BIT radioRxOverflowOccurred;
 
@@ -136,6 +310,138 @@ extern volatile BIT radioRxOverflowOccurred;
  * This should not happen. */
 extern volatile BIT radioTxUnderflowOccurred;
 
+/*! The number of RX overflows that have occurred
+ * (see #radioRxOverflowOccurred).
+ *
+ * This counter, like the other radioMac*Count counters, is incremented in an
+ * interrupt and stops at 255 instead of wrapping around.  The higher-level
+ * code may read it and set it back to zero. */
+extern volatile uint8 radioMacRxOverflowCount;
+
+/*! The number of TX underflows that have occurred
+ * (see #radioTxUnderflowOccurred). */
+extern volatile uint8 radioMacTxUnderflowCount;
+
+/*! The number of packets received with an invalid CRC. */
+extern volatile uint8 radioMacCrcErrorCount;
+
+/*! The number of #RADIO_MAC_EVENT_RX_TIMEOUT events that have occurred. */
+extern volatile uint8 radioMacRxTimeoutCount;
+
+/*! The number of times a transmission was cancelled because the channel
+ * was busy (see #radioMacListenBeforeTalk). */
+extern volatile uint8 radioMacChannelBusyCount;
+
+/*! This is a configuration option that can be set by higher-level code.
+ * The default value is 0.
+ *
+ * When this bit is 1, every time the higher-level code calls radioMacTx(),
+ * the library first puts the radio in RX mode for about 50&nbsp;us to see
+ * if the channel is clear (plus about 800&nbsp;us if the radio calibrates on
+ * the way to RX, which it would have done on the way to TX anyway).  The channel is considered busy if the radio is
+ * receiving a packet or the signal strength is above the carrier sense
+ * threshold (AGCCTRL1).
+ * If the channel is busy, the packet is not sent and radioMacEventHandler()
+ * is called again with #RADIO_MAC_EVENT_TX_BUSY.
+ *
+ * When you set this bit to 1, make sure your radioMacEventHandler() handles
+ * #RADIO_MAC_EVENT_TX_BUSY.  The handlers in <code>radio_queue.lib</code>,
+ * <code>radio_link.lib</code> and <code>radio_link_multi.lib</code> do. */
+extern BIT radioMacListenBeforeTalk;
+
+/*! Enables or disables the radio's hardware address filtering.
+ *
+ * \param address The address of this device.
+ * \param mode One of #RADIO_MAC_ADDRESS_CHECK_OFF,
+ *   #RADIO_MAC_ADDRESS_CHECK_NO_BROADCAST, #RADIO_MAC_ADDRESS_CHECK_BROADCAST_00, or
+ *   #RADIO_MAC_ADDRESS_CHECK_BROADCAST_00_FF.
+ *
+ * When address filtering is enabled, the radio compares the first byte after the
+ * length byte (packet[1]) to \p address (and to the broadcast addresses allowed by
+ * \p mode), and silently discards packets that do not match.  Those packets do not
+ * cause a #RADIO_MAC_EVENT_RX, so they cost much less CPU time.
+ * The hardware only supports 0x00 and 0xFF as broadcast addresses.
+ *
+ * While address filtering is enabled, the library uses the radio's SFD
+ * (start of frame) interrupt to restart the DMA transfer at the beginning of
+ * every packet.  That interrupt must run within one byte time of the SFD
+ * (about 23&nbsp;us at 350&nbsp;kbps), so keep other interrupts short.
+ * Packets for which it ran too late are discarded and counted in
+ * #radioMacCrcErrorCount.
+ *
+ * The radio does not report packets rejected by the filter, so while address
+ * filtering is enabled, an infinite RX timeout is replaced by a 50&nbsp;ms
+ * timeout that is handled inside this library.  That way a call to
+ * radioMacStrobe() that happens while a packet for another device is being
+ * received is handled within 50&nbsp;ms.  If FS_AUTOCAL is on, the radio
+ * calibrates each time it restarts RX.
+ *
+ * This should be called after radioMacInit(). */
+void radioMacAddressFilter(uint8 address, uint8 mode);
+
+/*! The number of entries in the trace buffer of
+ * <code>radio_mac_trace.lib</code>.  This must be a power of two.
+ * One entry is always left empty, so at most 31 entries can be waiting to be
+ * read. */
+#define RADIO_MAC_TRACE_SIZE 32
+
+/*! The event recorded in the trace buffer of <code>radio_mac_trace.lib</code>
+ * when the library decided to calibrate the frequency synthesizer (see
+ * radioMacCalibrateSoon()).  The calibration happens right after the event
+ * that is recorded next, and takes about 800&nbsp;us. */
+#define RADIO_MAC_TRACE_CALIBRATION         40
+
+/*! One entry in the trace buffer of <code>radio_mac_trace.lib</code>.
+ *
+ * Times are measured with Timer 4, which counts 188 ticks per millisecond
+ * (one tick is 5.33&nbsp;us). */
+typedef struct RADIO_MAC_TRACE_ENTRY
+{
+    /*! The lower 16 bits of getMs() when the radio interrupt started. */
+    uint16 ms;
+
+    /*! The number of Timer 4 ticks (0-187) after #ms when the radio
+     * interrupt started. */
+    uint8 ticks;
+
+    /*! The event that was passed to radioMacEventHandler(), or
+     * #RADIO_MAC_TRACE_CALIBRATION. */
+    uint8 event;
+
+    /*! What the higher-level code decided to do next: 1 for idle
+     * (radioMacIdle()), 2 for RX, or 3 for TX. */
+    uint8 state;
+
+    /*! The number of Timer 4 ticks from the start of the radio interrupt to
+     * the call to radioMacEventHandler(), or 255 if it was 255 or more. */
+    uint8 latency;
+
+    /*! The number of Timer 4 ticks that radioMacEventHandler() took, or 255 if
+     * it was 255 or more. */
+    uint8 duration;
+} RADIO_MAC_TRACE_ENTRY;
+
+/*! Reads the oldest entry from the trace buffer and removes it from the buffer.
+ *
+ * This function is only available in <code>radio_mac_trace.lib</code>, which
+ * is a build of <code>radio_mac.lib</code> that records the time of every
+ * call to radioMacEventHandler() and how long it took.  To use it, list
+ * <code>radio_mac_trace.lib</code> instead of <code>radio_mac.lib</code>
+ * in your app's APP_LIBS.  This is meant for measuring the timing of
+ * higher-level libraries, for example to find out why packets are lost.
+ * The extra work makes every radio interrupt take a few microseconds longer.
+ *
+ * This function should be called from the main loop, often enough that the
+ * buffer does not fill up.
+ *
+ * \param entry A pointer to where the entry will be written.
+ * \return 1 if an entry was read, 0 if the buffer is empty. */
+uint8 radioMacTraceRead(RADIO_MAC_TRACE_ENTRY XDATA * entry);
+
+/*! The number of trace entries that were lost because the trace buffer was
+ * full.  Only available in <code>radio_mac_trace.lib</code>. */
+extern volatile uint8 radioMacTraceLostCount;
+
 /*! The radio's Interrupt Service Routine (ISR). */
 ISR(RF, 0);
 
@@ -0,0 +1,124 @@
+/*! \file radio_mesh.h
+ * The <code>radio_mesh.lib</code> library lets Wixels send packets to each
+ * other over several hops, so two Wixels that are out of range of each other
+ * can communicate as long as there is a chain of Wixels between them.
+ * Every Wixel running this library relays packets for the others.
+ * This library depends on <code>radio_queue.lib</code> (or one of its other
+ * builds, such as <code>radio_queue_tdma.lib</code>).
+ *
+ * Every Wixel in the network must use this library and must have a different
+ * address (#param_radio_address).  Each packet carries the address of the
+ * Wixel that sent it (the source), the address of the Wixel it is for (the
+ * destination), a sequence number, and a time-to-live (TTL) that limits the
+ * number of hops it can take.
+ *
+ * Each Wixel keeps a routing table that says which neighbor to send packets
+ * to for each destination.  The table is learned from the packets the Wixel
+ * receives: when a packet from a source arrives through a neighbor, the
+ * neighbor becomes the route back to that source, unless there already is
+ * a cheaper route.  The cost of a route is the sum of the costs of its hops,
+ * and the cost of each hop depends on the RSSI of the packets received on it,
+ * so strong links are preferred.  Routes that have not been used for about
+ * a minute are forgotten.
+ *
+ * Packets to a destination that has no route yet, and packets sent to
+ * #RADIO_MESH_BROADCAST, are flooded: every Wixel that receives one relays
+ * it once.  Each Wixel remembers the source and sequence number of the
+ * packets it has seen recently, so it does not deliver or relay the same
+ * packet twice.
+ *
+ * Delivery is not reliable: just like with <code>radio_queue.lib</code>,
+ * packets can be lost.  Packets are relayed in the main loop by
+ * radioMeshService(), which copies each relayed packet from the RX queue to
+ * the TX queue once.
+ *
+ * This library depends on <code>radio_mac.lib</code>, which uses an interrupt.
+ * For this library to work, you must write
+ * <code>include <radio_mesh.h></code>
+ * in the source file that contains your main() function.
+ */
+
+#ifndef _RADIO_MESH_H_
+#define _RADIO_MESH_H_
+
+#include <radio_queue.h>
+
+/*! Each packet can contain at most 13 bytes of payload (with the default
+ * #RADIO_QUEUE_PAYLOAD_SIZE).  The other 6 bytes of
+ * a <code>radio_queue.lib</code> packet hold the mesh header. */
+#define RADIO_MESH_PAYLOAD_SIZE (RADIO_QUEUE_PAYLOAD_SIZE - 6)
+
+/*! The destination address that sends a packet to every Wixel in the
+ * network.  Do not use it as the address of a Wixel. */
+#define RADIO_MESH_BROADCAST 0xFF
+
+/*! The maximum number of destinations in the routing table. */
+#define RADIO_MESH_MAX_ROUTES 8
+
+/*! The address of this Wixel.  Valid values are from 0 to 254.
+ * Every Wixel in the network must have a different address.
+ * (This is a Wixel App parameter; the user can set
+ * it using the Wixel Configuration Utility.) */
+extern int32 CODE param_radio_address;
+
+/*! The maximum number of hops a packet sent by this Wixel can take, from 1
+ * to 15.  (This is a Wixel App parameter; the user can set
+ * it using the Wixel Configuration Utility.) */
+extern int32 CODE param_radio_mesh_ttl;
+
+/*! Initializes the <code>radio_mesh.lib</code> library and the
+ * lower-level libraries that it depends on.
+ * This must be called before any of the other radioMesh* functions. */
+void radioMeshInit(void);
+
+/*! Relays the packets in the RX queue that are for other Wixels, and
+ * updates the routing table.  This should be called regularly from the main
+ * loop.  It is also called by radioMeshRxCurrentPacket(). */
+void radioMeshService(void);
+
+/*! \return The number of TX packet buffers that are currently free.
+ * Packets that are relayed for other Wixels use the same buffers. */
+uint8 radioMeshTxAvailable(void);
+
+/*! \return A pointer to the current TX packet, or 0 if no packet is
+ * available.
+ *
+ * The packet has the same format as in radioQueueTxCurrentPacket():
+ * write the length of the payload (which must not exceed
+ * #RADIO_MESH_PAYLOAD_SIZE) to offset 0 and the data starting at offset 1,
+ * then call radioMeshTxSendPacket(). */
+uint8 XDATA * radioMeshTxCurrentPacket(void);
+
+/*! Sends the current TX packet.
+ *
+ * \param destination The address of the Wixel that should receive the
+ *   packet, or #RADIO_MESH_BROADCAST to send it to all of them. */
+void radioMeshTxSendPacket(uint8 destination);
+
+/*! \return A pointer to the current RX packet, or 0 if there is no RX packet
+ * available.  This only returns packets that were sent to this Wixel or
+ * broadcast.
+ *
+ * The RX packet has the same format as the TX packet: the length of the
+ * payload is at offset 0 and the data starts at offset 1.
+ *
+ * When you are done reading the packet you should call
+ * radioMeshRxDoneWithPacket() to advance to the next packet. */
+uint8 XDATA * radioMeshRxCurrentPacket(void);
+
+/*! \return The address of the Wixel that sent the current RX packet.
+ *
+ * This should only be called if radioMeshRxCurrentPacket() recently
+ * returned a non-zero pointer. */
+uint8 radioMeshRxCurrentSource(void);
+
+/*! Frees the current RX packet so that you can advance to processing
+ * the next one. */
+void radioMeshRxDoneWithPacket(void);
+
+/*! \return The address of the neighbor that packets to the given destination
+ * are sent through, or #RADIO_MESH_BROADCAST if there is no route to it
+ * (so its packets are flooded). */
+uint8 radioMeshNextHop(uint8 destination);
+
+#endif
@@ -0,0 +1,111 @@
+/*! \file radio_message.h
+ * The <code>radio_message.lib</code> library provides reliable, ordered
+ * delivery and reception of messages that can be larger than a single
+ * radio packet.
+ * This library depends on <code>radio_link.lib</code> (or
+ * <code>radio_link_window.lib</code>).
+ *
+ * Each message is split into fragments of up to
+ * #RADIO_MESSAGE_FRAGMENT_SIZE bytes, and each fragment is sent in one
+ * <code>radio_link.lib</code> packet with payload type
+ * #RADIO_MESSAGE_PAYLOAD_TYPE.  The receiving Wixel puts the fragments
+ * back together in a buffer and only gives the message to higher-level
+ * code when the whole message has arrived.
+ *
+ * This library reads every packet received by <code>radio_link.lib</code>,
+ * so it can not be used together with <code>radio_com.lib</code>.
+ * Received packets that have a different payload type are discarded.
+ *
+ * This library depends on <code>radio_link.lib</code>, which depends on
+ * <code>radio_mac.lib</code>, which uses an interrupt.
+ * For this library to work, you must write
+ * <code>include <radio_message.h></code>
+ * in the source file that contains your main() function.
+ */
+
+#ifndef _RADIO_MESSAGE_H_
+#define _RADIO_MESSAGE_H_
+
+#include <radio_link.h>
+
+/*! The number of message bytes carried in each radio packet.
+ * One byte of each packet is used to identify the fragment. */
+#define RADIO_MESSAGE_FRAGMENT_SIZE (RADIO_LINK_PAYLOAD_SIZE - 1)
+
+/*! The maximum number of fragments in a message.  The whole message has to
+ * fit in the <code>radio_link.lib</code> TX queue, which can hold one packet
+ * less than #RADIO_LINK_TX_PACKET_COUNT, and the fragment index has 6 bits. */
+#if RADIO_LINK_TX_PACKET_COUNT - 1 < 64
+#define RADIO_MESSAGE_MAX_FRAGMENTS (RADIO_LINK_TX_PACKET_COUNT - 1)
+#else
+#define RADIO_MESSAGE_MAX_FRAGMENTS 64
+#endif
+
+/*! The maximum length of a message, in bytes: 255 with the default
+ * #RADIO_LINK_PAYLOAD_SIZE and #RADIO_LINK_TX_PACKET_COUNT.  This is limited
+ * by the number of packets that <code>radio_link.lib</code> can queue. */
+#if RADIO_MESSAGE_MAX_FRAGMENTS * RADIO_MESSAGE_FRAGMENT_SIZE < 255
+#define RADIO_MESSAGE_MAX_SIZE (RADIO_MESSAGE_MAX_FRAGMENTS * RADIO_MESSAGE_FRAGMENT_SIZE)
+#else
+#define RADIO_MESSAGE_MAX_SIZE 255
+#endif
+
+/*! The <code>radio_link.lib</code> payload type used for message fragments.
+ * This is different from the payload types used by <code>radio_com.lib</code>
+ * (0, 1, 3, and 8 and up), so the two libraries can share a link. */
+#define RADIO_MESSAGE_PAYLOAD_TYPE 2
+
+/*! Initializes the <code>radio_message.lib</code> library and the
+ * lower-level libraries that it depends on.
+ * This must be called before any of the other radioMessage* functions. */
+void radioMessageInit(void);
+
+/*! \return 1 if there is enough room in the TX queue to send a message of
+ * the given length right now, 0 otherwise.
+ *
+ * \param length The length of the message, in bytes.  Must not exceed
+ *   #RADIO_MESSAGE_MAX_SIZE; longer messages can never be sent, so this
+ *   function always returns 0 for them. */
+BIT radioMessageTxAvailable(uint8 length);
+
+/*! Queues a message to be sent to the other Wixel.
+ *
+ * \param message A pointer to the message.  The message is copied, so the
+ *   buffer can be reused as soon as this function returns.
+ * \param length The length of the message, in bytes.
+ *
+ * This is a non-blocking function: you must call radioMessageTxAvailable()
+ * with the same length before calling this function, and it must have
+ * returned 1.
+ *
+ * Example usage:
+\code
+if (radioMessageTxAvailable(sizeof(record)))
+{
+    radioMessageTxSend((uint8 XDATA *)&record, sizeof(record));
+}
+\endcode
+ */
+void radioMessageTxSend(const uint8 XDATA * message, uint8 length);
+
+/*! \return A pointer to the current RX message, or 0 if no complete
+ *   message has been received.
+ *
+ * The length of the message can be found by calling
+ * radioMessageRxCurrentLength().
+ * When you are done reading the message, you should call
+ * radioMessageRxDoneWithMessage() so the buffer can be used to receive
+ * the next message. */
+uint8 XDATA * radioMessageRxCurrentMessage(void);
+
+/*! \return The length of the current RX message, in bytes.
+ *
+ * This should only be called if radioMessageRxCurrentMessage() recently
+ * returned a non-zero pointer. */
+uint8 radioMessageRxCurrentLength(void);
+
+/*! Frees the current RX message so that the next one can be received.
+ * See the radioMessageRxCurrentMessage() documentation for details. */
+void radioMessageRxDoneWithMessage(void);
+
+#endif /* _RADIO_MESSAGE_H_ */
@@ -4,6 +4,17 @@
  * does not ensure reliability, nor does it specify a format for the packet
  * contents, other than requiring the first byte of the packet to contain its
  * length. This library depends on <code>radio_mac.lib</code>.
+ *
+ * Between sending packets, this library listens for a random interval of
+ * 1-4 ms.  For networks with many transmitting Wixels, consider
+ * <code>radio_queue_tdma.lib</code> (see radio_queue_tdma.h), which gives
+ * each Wixel its own time slot.
+ *
+ * There are two TX queues: one for normal packets and a smaller one for urgent
+ * packets, such as alarms.  Whenever the library is ready to send a packet, it
+ * takes it from the urgent queue if that queue is not empty, so an urgent
+ * packet never waits behind more than the normal packet that is already being
+ * sent.  The functions without "Priority" in their names use the normal queue.
  */
 
 #ifndef _RADIO_QUEUE
@@ -13,8 +24,47 @@
 #include <radio_mac.h>
 
 /*! Each packet can contain at most 19 bytes of payload. (This was chosen to
- * match radio_link's 18-byte payload + 1-byte header.) */
+ * match radio_link's 18-byte payload + 1-byte header.)
+ *
+ * This, and the number of packet buffers (RADIO_QUEUE_RX_PACKET_COUNT,
+ * RADIO_QUEUE_TX_PACKET_COUNT, and RADIO_QUEUE_TX_URGENT_PACKET_COUNT, which
+ * default to 3, 16, and 4) can be changed by an app that compiles this library
+ * from source.  To do that, put these lines in the app's
+ * <code>options.mk</code>:
+ *
+\code
+APP_LIB_SOURCES := radio_queue
+APP_C_FLAGS := -DRADIO_QUEUE_PAYLOAD_SIZE=30 -DRADIO_QUEUE_RX_PACKET_COUNT=6
+\endcode
+ *
+ * The TX counts must be powers of 2.  If you change the payload size, any
+ * other library your app uses that is built on this one (such as
+ * <code>radio_mesh.lib</code>) must be in APP_LIB_SOURCES too. */
+#ifndef RADIO_QUEUE_PAYLOAD_SIZE
 #define RADIO_QUEUE_PAYLOAD_SIZE 19
+#endif
+
+/*! The size of each RX packet buffer: the length byte, the payload, and the
+ * two status bytes that the radio appends (RSSI and LQI/CRC).  Buffers passed
+ * to radioQueueRxTakePacket() must be at least this big. */
+#define RADIO_QUEUE_RX_BUFFER_SIZE (1 + RADIO_QUEUE_PAYLOAD_SIZE + 2)
+
+// Make sure buffers from packet_pool.lib are big enough for radioQueueRxTakePacket().
+#if defined(PACKET_POOL_BUFFER_SIZE) && PACKET_POOL_BUFFER_SIZE < RADIO_QUEUE_RX_BUFFER_SIZE
+#error "PACKET_POOL_BUFFER_SIZE is smaller than RADIO_QUEUE_RX_BUFFER_SIZE.  See packet_pool.h."
+#endif
+
+/*! Priority class for radioQueuePriorityTxCurrentPacket(): the normal TX queue,
+ * which holds up to 15 packets (one less than RADIO_QUEUE_TX_PACKET_COUNT). */
+#define RADIO_QUEUE_PRIORITY_NORMAL 0
+
+/*! Priority class for radioQueuePriorityTxCurrentPacket(): the urgent TX queue,
+ * which holds up to 3 packets (one less than RADIO_QUEUE_TX_URGENT_PACKET_COUNT).
+ * Packets in this queue are sent before any packets in the normal queue. */
+#define RADIO_QUEUE_PRIORITY_URGENT 1
+
+/*! The number of priority classes. */
+#define RADIO_QUEUE_PRIORITY_COUNT  2
 
 /*! Defines the frequency to use.  Valid values are from
  * 0 to 255.  To avoid interference, the channel numbers of
@@ -43,7 +93,8 @@ void radioQueueInit(void);
 uint8 radioQueueTxAvailable(void);
 
 /*! \return The number of radio packet buffers that are currently busy
- * (holding a data packet that has not been successfully sent yet).
+ * (holding a data packet that has not been successfully sent yet),
+ * in all of the TX queues.
  *
  * This function has no side effects. */
 uint8 radioQueueTxQueued(void);
@@ -75,6 +126,26 @@ uint8 XDATA * radioQueueTxCurrentPacket(void);
  */
 void radioQueueTxSendPacket(void);
 
+/*! Same as radioQueueTxAvailable(), but for the TX queue of the given
+ * priority class.
+ *
+ * \param priority #RADIO_QUEUE_PRIORITY_NORMAL or #RADIO_QUEUE_PRIORITY_URGENT. */
+uint8 radioQueuePriorityTxAvailable(uint8 priority);
+
+/*! Same as radioQueueTxCurrentPacket(), but for the TX queue of the given
+ * priority class.  After you have put the data in the packet, call
+ * radioQueuePriorityTxSendPacket() with the same priority.
+ *
+ * \param priority #RADIO_QUEUE_PRIORITY_NORMAL or #RADIO_QUEUE_PRIORITY_URGENT. */
+uint8 XDATA * radioQueuePriorityTxCurrentPacket(uint8 priority);
+
+/*! Sends the current TX packet of the given priority class.
+ *
+ * \param priority #RADIO_QUEUE_PRIORITY_NORMAL or #RADIO_QUEUE_PRIORITY_URGENT.
+ *   radioQueuePriorityTxCurrentPacket() must have recently returned a non-zero
+ *   pointer for this priority. */
+void radioQueuePriorityTxSendPacket(uint8 priority);
+
 /*! Returns a pointer to the current RX packet (the earliest packet received
  * by radio_queue which has not been processed yet by higher-level code).
  * Returns 0 if there is no RX packet available.
@@ -89,4 +160,20 @@ uint8 XDATA * radioQueueRxCurrentPacket(void);  // returns 0 if no packet is ava
  * the next one.  See the radioQueueRxCurrentPacket() documentation for details. */
 void radioQueueRxDoneWithPacket(void);
 
+/*! Takes ownership of the current RX packet, so it can be passed on to other
+ * code (for example, sent with uart0TxSendPacket()) without copying it, and
+ * gives radio_queue another buffer to receive packets into in its place.
+ * This advances to the next RX packet, like radioQueueRxDoneWithPacket().
+ *
+ * \param replacement A buffer of at least #RADIO_QUEUE_RX_BUFFER_SIZE bytes
+ *   that radio_queue will own from now on.  This is usually a buffer from
+ *   packetPoolAlloc() (see packet_pool.h) or a packet that was taken earlier.
+ *
+ * \return The current RX packet, in the same format as
+ * radioQueueRxCurrentPacket(), or 0 if there is no RX packet available (in
+ * which case radio_queue does not take the replacement).  The caller owns the
+ * returned buffer: it is #RADIO_QUEUE_RX_BUFFER_SIZE bytes long and can be
+ * given back later as a replacement, or to packetPoolFree(). */
+uint8 XDATA * radioQueueRxTakePacket(uint8 XDATA * replacement);
+
 #endif
@@ -0,0 +1,90 @@
+/*! \file radio_queue_tdma.h
+ * <code>radio_queue_tdma.lib</code> is a build of <code>radio_queue.lib</code>
+ * that shares the channel between many Wixels using time-division multiple
+ * access (TDMA) instead of random delays.  The API is the same as
+ * <code>radio_queue.lib</code> (see radio_queue.h), and it is selected by
+ * listing <code>radio_queue_tdma.lib</code> instead of
+ * <code>radio_queue.lib</code> in your app's APP_LIBS.
+ *
+ * Time is divided into frames of #param_radio_tdma_slot_count slots, and each
+ * slot is #RADIO_QUEUE_TDMA_SLOT_TIME microseconds long.  One Wixel on the
+ * channel is the coordinator: it has #param_radio_tdma_slot set to 0 (the
+ * default is 1, so one Wixel must be configured as the coordinator).  At the
+ * start of every frame, the coordinator transmits a beacon (a packet with no
+ * payload) followed by at most one packet from its TX queue.  It listens for
+ * packets the rest of the time.
+ *
+ * Every other Wixel (node) must have a different slot number between 1 and
+ * #param_radio_tdma_slot_count - 1.  A node synchronizes its frame with the
+ * beacon and transmits at most one packet from its TX queue during its own
+ * slot.  It turns the radio on to listen for the beacon and the coordinator's
+ * packet after it, and turns the radio off the rest of the time.  This means
+ * that the packets sent by nodes are only received by the coordinator.
+ * A node only transmits in frames whose beacon it received.  A node that
+ * misses 4 beacons in a row (plus half the number of hop channels, if
+ * hopping is enabled) listens all the time until it receives a beacon again.
+ *
+ * Because each Wixel has its own slot, packets do not collide no matter how
+ * many Wixels there are, and each node is guaranteed one packet per frame.
+ * With the default of 8 slots, a frame is 21.3 ms long.
+ *
+ * If #param_radio_hop_channels is more than 1, every frame is sent on a
+ * different channel, following a pseudo-random hop sequence that is shared by
+ * all the Wixels (see radioMacHopInit()).  The coordinator keeps statistics of
+ * the packets it receives on each channel and blacklists channels with a high
+ * error rate, for example because a Wi-Fi network is using them.  It does not
+ * send a beacon in frames on a blacklisted channel, so those frames are not used.
+ * A node that is not synchronized waits on each channel of the hop sequence in
+ * turn until it receives a beacon.
+ *
+ * This library uses Timer 3 and its interrupt to keep track of the slots.
+ * For this library to work, you must write
+ * <code>include <radio_queue_tdma.h></code>
+ * in the source file that contains your main() function.
+ */
+
+#ifndef _RADIO_QUEUE_TDMA
+#define _RADIO_QUEUE_TDMA
+
+#include <cc2511_map.h>
+#include <radio_queue.h>
+
+/*! The length of one TDMA slot, in microseconds.  This is enough time to
+ * send one packet of the maximum size, including the time needed to
+ * calibrate the frequency synthesizer. */
+#define RADIO_QUEUE_TDMA_SLOT_TIME 2667
+
+/*! The slot number of this Wixel.  The coordinator must use slot 0, and
+ * every other Wixel on the same channel must use a different slot between
+ * 1 and #param_radio_tdma_slot_count - 1.  (This is a Wixel App parameter;
+ * the user can set it using the Wixel Configuration Utility.)
+ *
+ * The default value is 1, so a Wixel is a node unless it is configured
+ * otherwise.  Exactly one Wixel on the channel must be set to 0 to be the
+ * coordinator; without one, no beacons are sent and the nodes never
+ * transmit.  When there are more than two Wixels, the nodes also need
+ * different slot numbers. */
+extern int32 CODE param_radio_tdma_slot;
+
+/*! The number of slots in each frame.  Valid values are from 2 to 255, and
+ * every Wixel on the same channel must use the same value.  (This is a Wixel
+ * App parameter; the user can set it using the Wixel Configuration Utility.) */
+extern int32 CODE param_radio_tdma_slot_count;
+
+/*! The number of channels to hop between, from 1 to
+ * #RADIO_MAC_HOP_MAX_CHANNELS.  The channels are spread evenly over the
+ * band, starting at #param_radio_channel.  The default value of 1 disables
+ * hopping.  Every Wixel on the same channel must use the same value.
+ * (This is a Wixel App parameter; the user can set it using the Wixel
+ * Configuration Utility.) */
+extern int32 CODE param_radio_hop_channels;
+
+/*! \return 1 if this Wixel is synchronized with the coordinator's frames
+ * (or is the coordinator), 0 otherwise.  A node only transmits packets while
+ * it is synchronized. */
+uint8 radioQueueTdmaSynchronized(void);
+
+/*! Timer 3 interrupt. */
+ISR(T3, 0);
+
+#endif
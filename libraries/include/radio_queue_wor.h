@@ -0,0 +1,46 @@
+/*! \file radio_queue_wor.h
+ * <code>radio_queue_wor.lib</code> is a build of <code>radio_queue.lib</code>
+ * for battery-powered Wixels that only turns on the radio receiver for a short
+ * time in each wake-up period, instead of listening all the time.
+ * The API is the same as <code>radio_queue.lib</code> (see radio_queue.h), and
+ * it is selected by listing <code>radio_queue_wor.lib</code> instead of
+ * <code>radio_queue.lib</code> in your app's APP_LIBS.
+ *
+ * Every #param_radio_wor_period milliseconds, the radio listens for about
+ * 2 ms, and then it is turned off (put in the IDLE state) for the rest of the
+ * period.  With the default period of 100 ms, the receiver is on about 2% of
+ * the time; a period of 40 ms gives about 5% and 200 ms gives about 1%.
+ *
+ * To make sure that the other Wixels hear a packet, each packet is sent over
+ * and over again for a whole period (plus 3 ms), so the other Wixels will
+ * receive one of the copies during their next listening window.
+ * After a Wixel receives a packet, it does not listen again until the sender
+ * is done sending copies of that packet, so each packet is only received once.
+ * This means that a packet is received within one period after it is sent,
+ * but it takes a whole period to send each packet, so the throughput is low.
+ * Every Wixel on the same channel must use the same period.
+ *
+ * This library only controls the radio.  To save more power, your app can put
+ * the processor to sleep between radio events.
+ *
+ * This library uses Timer 3 and its interrupt to time the wake-up periods.
+ * For this library to work, you must write
+ * <code>include <radio_queue_wor.h></code>
+ * in the source file that contains your main() function.
+ */
+
+#ifndef _RADIO_QUEUE_WOR
+#define _RADIO_QUEUE_WOR
+
+#include <cc2511_map.h>
+#include <radio_queue.h>
+
+/*! The wake-up period in milliseconds.  Valid values are from 10 to 10000.
+ * Every Wixel on the same channel must use the same value.  (This is a Wixel
+ * App parameter; the user can set it using the Wixel Configuration Utility.) */
+extern int32 CODE param_radio_wor_period;
+
+/*! Timer 3 interrupt. */
+ISR(T3, 0);
+
+#endif
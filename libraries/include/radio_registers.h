@@ -3,6 +3,9 @@
  * This header file provides a function for configuring the
  * radio registers (radioRegistersInit()) and also some small
  * functions for reading information from the radio.
+ *
+ * It also provides a cache of frequency synthesizer calibrations for fast
+ * switching between channels (radioChannelCacheInit()).
  */
 
 #ifndef _RADIO_REGISTERS_H
@@ -20,6 +23,10 @@
  * - Channel spacing = 286.4 kHz
  * - Channel bandwidth = 600 kHz
  *
+ * The data rate and channel bandwidth come from the PHY profile that was
+ * last selected with radioSetProfile() (#RADIO_PROFILE_DEFAULT if it was
+ * never called).
+ *
  * This function does not configure the PKTLEN, MCSM0, MCSM1, MCSM2, CHANNR,
  * or ADDR registers or the DMA:  That should be done by higher-level code.
  */
@@ -51,6 +58,61 @@ uint8 radioLqi();
  * RSSI stands for Received Signal Strength Indication. */
 int8 radioRssi();
 
+/*! PHY profile for radioSetProfile(): 100 kbps with a channel bandwidth of
+ * 300 kHz.  The lower data rate and narrower filter make the receiver more
+ * sensitive, so this profile works at a longer range than the others, but
+ * packets take 3.5 times longer to send (about 2.7&nbsp;ms for a full
+ * <code>radio_queue.lib</code> packet, including the preamble and sync word).
+ *
+ * <code>radio_link.lib</code> and <code>radio_queue.lib</code> work with this
+ * profile: their RX timeouts only need to cover the preamble and sync word of
+ * the next packet, and the retransmission timeout of
+ * <code>radio_link.lib</code> is measured.  <code>radio_queue_wor.lib</code>
+ * uses longer listening windows with this profile.
+ * <code>radio_queue_tdma.lib</code> does not support this profile, because
+ * its 2.7&nbsp;ms slots are too short for a packet. */
+#define RADIO_PROFILE_LONG_RANGE  0
+
+/*! PHY profile for radioSetProfile(): 350 kbps with a channel bandwidth of
+ * 600 kHz.  This is the profile used by radioRegistersInit() by default. */
+#define RADIO_PROFILE_DEFAULT     1
+
+/*! PHY profile for radioSetProfile(): 375 kbps with a channel bandwidth of
+ * 600 kHz, for short links.  Higher data rates caused lots of packet errors
+ * in our tests. */
+#define RADIO_PROFILE_FAST        2
+
+/*! The number of PHY profiles. */
+#define RADIO_PROFILE_COUNT       3
+
+/*! Reprograms the radio's data rate and channel bandwidth (MDMCFG4, MDMCFG3,
+ * and FSCTRL1) using one of the built-in PHY profiles, and updates
+ * #radioRssiOffset to match.  All profiles use MSK modulation and the same
+ * channel frequencies, so the frequency synthesizer does not need to be
+ * calibrated again.
+ *
+ * This function puts the radio in the IDLE state, so it should be called
+ * before radioMacInit() or from radioMacEventHandler().  The profile is kept
+ * when radioRegistersInit() is called again.
+ *
+ * Both ends of a link must use the same profile.  Deciding when to switch
+ * (and telling the other Wixel) is up to the higher-level code.
+ *
+ * The radio's forward error correction is not used by any profile because it
+ * only works with fixed-length packets.
+ *
+ * \param profile One of #RADIO_PROFILE_LONG_RANGE, #RADIO_PROFILE_DEFAULT, or
+ *   #RADIO_PROFILE_FAST.  Invalid values are ignored. */
+void radioSetProfile(uint8 profile);
+
+/*! \return The PHY profile that is being used (see radioSetProfile()). */
+uint8 radioGetProfile(void);
+
+/*! The offset used by radioRssi() to calculate the RSSI.  The RSSI offset
+ * depends on the data rate, so radioSetProfile() updates this variable.
+ * The default value is #RSSI_OFFSET. */
+extern int8 radioRssiOffset;
+
 /*! \return 1 if the last packet received has a correct CRC-16,
  * 0 otherwise.
  *
@@ -58,7 +120,51 @@ int8 radioRssi();
  * was corrupted and should not be relied upon. */
 BIT radioCrcPassed();
 
-/*! An offset used by radioRssi() to calculate the RSSI.
+/*! The maximum number of channels that radioChannelCacheInit() supports. */
+#define RADIO_CHANNEL_CACHE_SIZE 16
+
+/*! Sets up a cache of frequency synthesizer calibrations for a list of
+ * channels, so that the radio can switch between them quickly.
+ *
+ * \param channels An array of CHANNR values.
+ * \param count The number of channels in the array.  At most
+ *   #RADIO_CHANNEL_CACHE_SIZE channels are used.
+ *
+ * Each channel is identified by its index in the array.  The cache starts
+ * out empty: call radioChannelCacheCalibrate() to fill it. */
+void radioChannelCacheInit(const uint8 * channels, uint8 count);
+
+/*! Calibrates the frequency synthesizer for every channel that was passed to
+ * radioChannelCacheInit() and stores the results (the FSCAL3, FSCAL2, and
+ * FSCAL1 registers).  This takes about 800 us per channel and leaves the
+ * radio in the IDLE state on the last channel.
+ *
+ * The calibration depends on the temperature and supply voltage, so you might
+ * want to call this function again if they change.  You must also call it
+ * again after radioRegistersInit(), which overwrites the FSCAL registers. */
+void radioChannelCacheCalibrate(void);
+
+/*! Puts the radio in the IDLE state, switches it to the channel with the given
+ * index, and restores the calibration of that channel, so the radio can go
+ * to RX or TX mode without calibrating.  This takes tens of microseconds
+ * instead of the 800 us needed for a calibration.
+ *
+ * This function also disables automatic calibration (MCSM0.FS_AUTOCAL = 0),
+ * since that would overwrite the calibration it restores.
+ *
+ * If the radio was calibrated again while it was on the previous channel, that
+ * calibration is saved in the cache before switching.  For this reason, you
+ * should not change CHANNR in other ways while you are using the cache.
+ *
+ * \param index The index of the channel in the array that was passed to
+ *   radioChannelCacheInit().
+ * \return 1 if the calibration was restored, or 0 if there is no calibration
+ *   for that channel in the cache yet, in which case the radio needs to be
+ *   calibrated before it is used.  It is also 0 if \p index is not less than
+ *   the number of channels in the cache; then nothing is changed. */
+uint8 radioChannelCacheSelect(uint8 index);
+
+/*! The RSSI offset of the default profile (see #radioRssiOffset).
  * According to Table 68 of the CC2511F32 datasheet, RSSI
  * offset for 250kbps is 71. */
 #define RSSI_OFFSET 71
@@ -5,6 +5,11 @@
  *  so it is capable of sending
  *  and receiving a continuous stream of bytes with no gaps.
  *
+ *  At high baud rates, the TX interrupt that runs for every byte can take a
+ *  lot of the CPU's time.  You can call uart0TxDmaEnable() to have the DMA
+ *  controller send the bytes instead; then there is only one interrupt for each
+ *  block of bytes.
+ *
  *  To use this library, you must include uart0.h or uart1.h in your app:
 \code
 #include <uart0.h>  // for UART 0
@@ -67,6 +72,21 @@ void uart0SetParity(uint8 parity);
  */
 void uart0SetStopBits(uint8 stopBits);
 
+/*! Makes the library send bytes with DMA channel #DMA_CHANNEL_UART
+ * instead of the TX interrupt.  The bytes added to the TX buffer (or given to
+ * uart0TxSendPacket()) are sent in blocks, with one DMA interrupt at the end
+ * of each block.  This should be called after uart0Init(), before sending any
+ * bytes.
+ *
+ * Only one of the two UARTs can use DMA: do not call this function and
+ * uart1TxDmaEnable() in the same app.
+ *
+ * If the DMA interrupt is delayed by more than one byte time (for example, by
+ * a long interrupt with a higher priority), the next block might not start
+ * until the next time one of the uart0Tx* functions is called.
+ */
+void uart0TxDmaEnable(void);
+
 /*! \return The number of bytes available in the TX buffer.
  */
 uint8 uart0TxAvailable(void);
@@ -90,6 +110,27 @@ void uart0TxSendByte(uint8 byte);
  */
 void uart0TxSend(const uint8 XDATA * buffer, uint8 size);
 
+/*! Sends bytes on UART0's TX line straight from the given buffer, without
+ * copying them into the TX buffer.  They are sent after the bytes that are
+ * already in the TX buffer, and before the bytes added to it later.  This is a
+ * non-blocking function: you must call uart0TxPacketPending() before calling
+ * it and only call it if that returned 0.
+ *
+ * The library owns the buffer until uart0TxPacketPending() returns 0, so the
+ * buffer must not be changed or reused before then.  This is meant for
+ * passing on packets from other libraries without copying them (see
+ * packet_pool.h).
+ *
+ * \param buffer  A pointer to the bytes to send.
+ * \param size    The number of bytes to send.
+ */
+void uart0TxSendPacket(const uint8 XDATA * buffer, uint8 size);
+
+/*! \return The number of bytes from the last uart0TxSendPacket() call that
+ * have not been sent yet.
+ */
+uint8 uart0TxPacketPending(void);
+
 /*! \return The number of bytes in the RX buffer.
  *
  * You can use this function to see if any bytes have been received, and
@@ -115,6 +156,9 @@ ISR(UTX0, 0);
 /*! Receive interrupt. */
 ISR(URX0, 0);
 
+/*! DMA interrupt, used by uart0TxDmaEnable(). */
+ISR(DMA, 0);
+
 /*! The library sets this to 1 whenever a parity error occurs. */
 extern volatile BIT uart0RxParityErrorOccurred;
 
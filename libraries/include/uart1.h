@@ -15,13 +15,17 @@ void uart1Init();
 void uart1SetBaudRate(uint32 baudrate);
 void uart1SetParity(uint8 parity);
 void uart1SetStopBits(uint8 stopBits);
+void uart1TxDmaEnable(void);
 uint8 uart1TxAvailable(void);
 void uart1TxSendByte(uint8 byte);
 void uart1TxSend(const uint8 XDATA * buffer, uint8 size);
+void uart1TxSendPacket(const uint8 XDATA * buffer, uint8 size);
+uint8 uart1TxPacketPending(void);
 uint8 uart1RxAvailable(void);
 uint8 uart1RxReceiveByte(void);
 ISR(UTX1, 0);
 ISR(URX1, 0);
+ISR(DMA, 0);
 extern volatile BIT uart1RxParityErrorOccurred;
 extern volatile BIT uart1RxFramingErrorOccurred;
 extern volatile BIT uart1RxBufferFullOccurred;
@@ -1,4 +1,4 @@
-DEFAULT_LIBRARIES = radio_com.lib radio_link.lib radio_mac.lib radio_registers.lib \
+DEFAULT_LIBRARIES = radio_com.lib radio_message.lib radio_link.lib radio_mac.lib radio_registers.lib \
   random.lib uart.lib usb.lib usb_cdc_acm.lib wixel.lib adc.lib gpio.lib dma.lib
 
 # This template defines the things we want to add to the makefile for each library.
@@ -8,3 +8,26 @@ void dmaInit()
 {
     DMA1CFG = (uint16)&dmaConfig;
 }
+
+void dmaCopy(uint8 XDATA * dest, const uint8 XDATA * source, uint16 size)
+{
+    dmaConfig.copy.SRCADDRH = (uint16)source >> 8;
+    dmaConfig.copy.SRCADDRL = (uint16)source;
+    dmaConfig.copy.DESTADDRH = (uint16)dest >> 8;
+    dmaConfig.copy.DESTADDRL = (uint16)dest;
+    dmaConfig.copy.VLEN_LENH = size >> 8;  // Transfer length is fixed (VLEN = 0).
+    dmaConfig.copy.LENL = size;
+    dmaConfig.copy.DC6 = 0x20; // WORDSIZE = 0, TMODE = 1 (block), TRIG = 0 (manual)
+    dmaConfig.copy.DC7 = 0x51; // SRCINC = 1, DESTINC = 1, IRQMASK = 0, M8 = 0, PRIORITY = 1
+
+    DMAARM |= (1<<DMA_CHANNEL_COPY);
+
+    // The channel takes a few clock cycles to load its configuration after
+    // being armed, and a trigger that arrives during that time might be lost,
+    // so keep triggering it until the block transfer is done.  The channel
+    // disarms itself at the end of the block.
+    while(DMAARM & (1<<DMA_CHANNEL_COPY))
+    {
+        DMAREQ = (1<<DMA_CHANNEL_COPY);
+    }
+}
@@ -0,0 +1,57 @@
+/* packet_pool.c:
+ *  The free buffers are kept in a linked list: the first two bytes of each free
+ *  buffer hold a pointer to the next one.  This lets packetPoolFree accept any buffer
+ *  that is big enough, without a table that limits how many buffers there can be.
+ */
+
+#include <packet_pool.h>
+
+#if PACKET_POOL_COUNT < 1 || PACKET_POOL_COUNT > 255
+#error "PACKET_POOL_COUNT must be between 1 and 255."
+#endif
+
+#if PACKET_POOL_BUFFER_SIZE < 2
+#error "PACKET_POOL_BUFFER_SIZE must be at least 2 to hold the free list pointer."
+#endif
+
+static uint8 XDATA poolStorage[PACKET_POOL_COUNT][PACKET_POOL_BUFFER_SIZE];
+
+static uint8 XDATA * DATA poolFirst = 0;   // The first free buffer, or 0.
+static uint8 DATA poolCount = 0;           // The number of free buffers.
+
+void packetPoolInit()
+{
+    uint8 i;
+
+    poolFirst = 0;
+    poolCount = 0;
+    for (i = 0; i < PACKET_POOL_COUNT; i++)
+    {
+        packetPoolFree(poolStorage[i]);
+    }
+}
+
+uint8 XDATA * packetPoolAlloc()
+{
+    uint8 XDATA * buffer = poolFirst;
+    if (buffer == 0)
+    {
+        return 0;
+    }
+
+    poolFirst = *(uint8 XDATA * XDATA *)buffer;
+    poolCount--;
+    return buffer;
+}
+
+void packetPoolFree(uint8 XDATA * buffer)
+{
+    *(uint8 XDATA * XDATA *)buffer = poolFirst;
+    poolFirst = buffer;
+    poolCount++;
+}
+
+uint8 packetPoolAvailable()
+{
+    return poolCount;
+}
@@ -0,0 +1,148 @@
+/* radio_aggregate.c:
+ *  This layer uses radio_queue.c to send several small records in each packet.  After
+ *  the radio_queue length byte, the packet holds the records one after the other.  Each
+ *  record starts with a one byte header that holds its type (bits 7:5) and the length
+ *  of its data (bits 4:0), followed by the data.
+ *
+ *  The current TX packet stays in the radio_queue TX queue while records are added to
+ *  it; its length byte is the number of bytes used so far.  The current RX packet stays
+ *  in the radio_queue RX queue until its last record has been read.
+ */
+
+#include <radio_aggregate.h>
+#include <time.h>
+
+/* PACKET VARIABLES AND DEFINES ***********************************************/
+
+#define RADIO_AGGREGATE_PACKET_LENGTH_OFFSET 0
+
+#define RECORD_TYPE_BIT_OFFSET  5
+#define RECORD_LENGTH_MASK      0x1F
+
+#if RADIO_QUEUE_PAYLOAD_SIZE < 2
+#error "RADIO_QUEUE_PAYLOAD_SIZE is too small to hold a record."
+#endif
+
+uint8 radioAggregateTxMaxDelay = 20;
+
+static uint8 XDATA * DATA txPacket = 0;  // The packet records are being added to, or 0.
+static uint8 txStartTime;                // Lower 8 bits of getMs() when the first record was added.
+
+static uint8 DATA rxOffset = 0;          // The offset of the current RX record's header, or 0.
+
+/* GENERAL FUNCTIONS **********************************************************/
+
+void radioAggregateInit()
+{
+    radioQueueInit();
+}
+
+/* TX FUNCTIONS ***************************************************************/
+
+void radioAggregateTxFlush()
+{
+    if (txPacket != 0)
+    {
+        radioQueueTxSendPacket();
+        txPacket = 0;
+    }
+}
+
+void radioAggregateService()
+{
+    if (txPacket != 0 &&
+        (txPacket[RADIO_AGGREGATE_PACKET_LENGTH_OFFSET] >= RADIO_QUEUE_PAYLOAD_SIZE - 1 ||
+        (uint8)(getMs() - txStartTime) >= radioAggregateTxMaxDelay))
+    {
+        radioAggregateTxFlush();
+    }
+}
+
+uint8 XDATA * radioAggregateTxRecord(uint8 type, uint8 length)
+{
+    uint8 XDATA * record;
+
+    if (length > RADIO_AGGREGATE_MAX_RECORD_SIZE)
+    {
+        return 0;
+    }
+
+    if (txPacket != 0 && length >= RADIO_QUEUE_PAYLOAD_SIZE - txPacket[RADIO_AGGREGATE_PACKET_LENGTH_OFFSET])
+    {
+        // The record does not fit in the current packet.
+        radioAggregateTxFlush();
+    }
+
+    if (txPacket == 0)
+    {
+        txPacket = radioQueueTxCurrentPacket();
+        if (txPacket == 0)
+        {
+            return 0;
+        }
+        txPacket[RADIO_AGGREGATE_PACKET_LENGTH_OFFSET] = 0;
+        txStartTime = (uint8)getMs();
+    }
+
+    record = txPacket + 1 + txPacket[RADIO_AGGREGATE_PACKET_LENGTH_OFFSET];
+    record[0] = (type << RECORD_TYPE_BIT_OFFSET) | length;
+    txPacket[RADIO_AGGREGATE_PACKET_LENGTH_OFFSET] += 1 + length;
+    return record + 1;
+}
+
+/* RX FUNCTIONS ***************************************************************/
+
+uint8 XDATA * radioAggregateRxCurrentRecord()
+{
+    uint8 XDATA * packet;
+
+    while ((packet = radioQueueRxCurrentPacket()) != 0)
+    {
+        uint8 length = packet[RADIO_AGGREGATE_PACKET_LENGTH_OFFSET];
+
+        if (rxOffset == 0)
+        {
+            rxOffset = 1;
+        }
+
+        // Make sure the whole record is inside the packet, in case it was not sent
+        // by radio_aggregate.
+        if (rxOffset <= length && (packet[rxOffset] & RECORD_LENGTH_MASK) <= length - rxOffset)
+        {
+            return packet + rxOffset + 1;
+        }
+
+        // We have read all the records in this packet.
+        radioQueueRxDoneWithPacket();
+        rxOffset = 0;
+    }
+
+    return 0;
+}
+
+uint8 radioAggregateRxCurrentType()
+{
+    return radioQueueRxCurrentPacket()[rxOffset] >> RECORD_TYPE_BIT_OFFSET;
+}
+
+uint8 radioAggregateRxCurrentLength()
+{
+    return radioQueueRxCurrentPacket()[rxOffset] & RECORD_LENGTH_MASK;
+}
+
+void radioAggregateRxDoneWithRecord()
+{
+    uint8 XDATA * packet = radioQueueRxCurrentPacket();
+    uint8 end = rxOffset + (packet[rxOffset] & RECORD_LENGTH_MASK);  // The offset of the last byte of the record.
+
+    if (end >= packet[RADIO_AGGREGATE_PACKET_LENGTH_OFFSET])
+    {
+        // That was the last record in this packet.
+        radioQueueRxDoneWithPacket();
+        rxOffset = 0;
+    }
+    else
+    {
+        rxOffset = end + 1;
+    }
+}
@@ -1,12 +1,53 @@
 #include <radio_link.h>
 #include <radio_com.h>
+#include <dma.h>
+#include <time.h>
 
 #define PAYLOAD_TYPE_DATA 0
 #define PAYLOAD_TYPE_CONTROL_SIGNALS 1
 
+// A channel credit packet tells the other Wixel how much data of each buffered
+// channel (1 and up) the higher-level code has read, so it only sends data that
+// we have room for (see radioComSendChannelsNow).  It holds our epoch, the
+// other Wixel's epoch that our counts are relative to (or NO_EPOCH), and then
+// for each channel the low 8 bits of the running count of bytes read.
+// An epoch identifies one set of running counts: a Wixel starts a new one
+// whenever the other Wixel might have lost track of its counts (at startup
+// and after a reset packet), and starts counting the bytes it sends from 0.
+#define PAYLOAD_TYPE_CHANNEL_CREDIT 3
+#define NO_EPOCH 0x80
+
+// Data for channel 1 is sent with this payload type, data for channel 2 is
+// sent with the next one, and so on.  Channel 0 uses PAYLOAD_TYPE_DATA so
+// that it is compatible with Wixels that do not know about channels.
+#define PAYLOAD_TYPE_FIRST_CHANNEL 8
+
+// The number of channels that have their own TX buffers (every channel except channel 0).
+#define EXTRA_CHANNELS (RADIO_COM_CHANNEL_COUNT - 1)
+
+// Each channel's RX buffer holds two packets' worth of data, so that the other
+// Wixel can send the next packet for a channel while the previous one is being read.
+#if RADIO_LINK_PAYLOAD_SIZE > 127
+#define RX_CHANNEL_BUFFER_SIZE 255
+#else
+#define RX_CHANNEL_BUFFER_SIZE (2 * RADIO_LINK_PAYLOAD_SIZE)
+#endif
+
+// We send a channel credit packet once the higher-level code has read this many bytes
+// of a channel since the last one.  The other Wixel can always send a full packet
+// while it is waiting for that credit.
+#if RX_CHANNEL_BUFFER_SIZE - RADIO_LINK_PAYLOAD_SIZE > 0
+#define CREDIT_REPORT_THRESHOLD (RX_CHANNEL_BUFFER_SIZE - RADIO_LINK_PAYLOAD_SIZE)
+#else
+#define CREDIT_REPORT_THRESHOLD 1
+#endif
+
 BIT radioComRxEnforceOrdering = 0;
+uint8 radioComTxMinFill = 1;
+uint8 radioComTxMaxDelay = 0;
 
 static uint8 DATA txBytesLoaded = 0;
+static uint8 txStartTime;  // Lower 8 bits of getMs() when the first byte of the current TX packet was loaded.
 static uint8 DATA rxBytesLeft = 0;
 
 static uint8 XDATA * DATA rxPointer = 0;
@@ -18,34 +59,167 @@ static uint8 radioComTxSignals = 0;
 static uint8 lastRxSignals = 0; // The last RX signals sent to the higher-level code.
 static BIT sendSignalsSoon = 0; // 1 iff we should transmit control signals soon
 
+// Channels 1 and up are buffered here because the radio_link TX and RX queues can
+// only be accessed in order.  Each one has a packet's worth of TX buffer and an
+// RX buffer of RX_CHANNEL_BUFFER_SIZE bytes.  The other Wixel only sends data for
+// them that fits in our RX buffer, so a channel that is not being read never
+// holds up the radio_link RX queue.
+static uint8 XDATA txChannelBuffer[EXTRA_CHANNELS][RADIO_LINK_PAYLOAD_SIZE];
+static uint8 XDATA txChannelBytesLoaded[EXTRA_CHANNELS];
+static uint8 XDATA txChannelStartTime[EXTRA_CHANNELS];
+static uint8 XDATA txChannelSent[EXTRA_CHANNELS];          // Running count of bytes sent in this epoch (low 8 bits).
+static uint8 XDATA txChannelPeerConsumed[EXTRA_CHANNELS];  // Running count of bytes read by the other Wixel in this epoch.
+static uint8 XDATA txChannelEpoch = 0;  // Our epoch (0 to 0x7F).
+static BIT txChannelEpochStarted = 0;   // 1 iff we sent a credit packet with txChannelEpoch, so the counts above have started.
+static BIT sendCreditSoon = 0;          // 1 iff we should transmit a channel credit packet soon
+static BIT channelsUsed = 0;            // 1 iff either Wixel has used channels 1 and up, so credit packets are OK to send.
+
+// Credit packets are only sent once channels are in use, because older
+// versions of this library stop receiving when they get an unknown payload type.
+#define WAITING_TO_SEND_CREDIT (sendCreditSoon && channelsUsed)
+
+// The RX buffers are indexed by channel number.  Channel 0 normally uses the
+// radio_link packets directly, but once the other Wixel has used another channel,
+// channel 0 data is copied to rxChannelBuffer[0] as well, so that unread channel 0
+// data does not hold up the other channels.
+static uint8 XDATA rxChannelBuffer[RADIO_COM_CHANNEL_COUNT][RX_CHANNEL_BUFFER_SIZE];
+static uint8 XDATA rxChannelBytesLeft[RADIO_COM_CHANNEL_COUNT];
+static uint8 XDATA rxChannelOffset[RADIO_COM_CHANNEL_COUNT];
+static uint8 XDATA rxChannelConsumed[EXTRA_CHANNELS];  // Running count of bytes read by the higher-level code in the other Wixel's epoch.
+static uint8 XDATA rxChannelReported[EXTRA_CHANNELS];  // The value of rxChannelConsumed in the last credit packet.
+static uint8 XDATA rxChannelEpoch = NO_EPOCH;          // The other Wixel's epoch, from its last credit packet.
+static BIT rxChannel0Buffered = 0;  // 1 iff channel 0 data is copied to rxChannelBuffer[0].
+
+static uint8 txNextChannel = 0; // The buffered channel that gets the next free packet slot (index into txChannel* arrays).
+static BIT txChannelWaiting = 0; // 1 iff a buffered channel has a packet that is ready to be sent
+
 // For highest throughput, we want to send as much data in each packet
 // as possible.  But for lower latency, we sometimes need to send packets
 // that are NOT full.
 // This library will only send non-full packets if the number of packets
 // currently queued to be sent is small.  Specifically, that number must
-// not exceed TX_QUEUE_THRESHOLD.
+// not exceed TX_QUEUE_THRESHOLD.  The higher-level code can change this
+// policy with radioComTxMinFill, radioComTxMaxDelay, and radioComTxFlush.
 // A higher threshold means that there will be more under-populated packets
 // at the beginning of a data transfer (which is bad), but slightly reduces
 // the importance of calling radioComTxService often (which can be good).
 #define TX_QUEUE_THRESHOLD  1
 
+// radioComTxSend and radioComRxReceive use DMA to copy spans of at least
+// this many bytes.  Shorter spans are copied with a loop because setting up
+// the DMA channel takes about as long as copying a few bytes.
+#define DMA_COPY_THRESHOLD  8
+
 void radioComInit()
 {
     radioLinkInit();
+
+    // Tell the other Wixel to start counting from 0 (see radioComSendChannelCreditNow).
+    sendCreditSoon = 1;
+}
+
+static void copyBytes(uint8 XDATA * dest, const uint8 XDATA * source, uint8 size)
+{
+    if (size >= DMA_COPY_THRESHOLD)
+    {
+        dmaCopy(dest, source, size);
+    }
+    else
+    {
+        while(size)
+        {
+            *dest++ = *source++;
+            size--;
+        }
+    }
 }
 
 /** RX FUNCTIONS **************************************************************/
 
 #define WAITING_TO_REPORT_RX_SIGNALS (radioComRxEnforceOrdering && radioComRxSignals != lastRxSignals)
 
+// Copies the data from the packet to the RX buffer of the given channel.
+// Returns 0 if there is not enough room in the buffer.
+static uint8 rxChannelStore(uint8 channel, const uint8 XDATA * packet)
+{
+    uint8 length = packet[0];
+    uint8 left = rxChannelBytesLeft[channel];
+    uint8 offset = rxChannelOffset[channel];
+    uint8 XDATA * buffer = rxChannelBuffer[channel];
+
+    if (left > RX_CHANNEL_BUFFER_SIZE - length)
+    {
+        return 0;
+    }
+
+    if (offset > RX_CHANNEL_BUFFER_SIZE - length - left)
+    {
+        // There is not enough room after the unread data, so move it to the
+        // beginning of the buffer.  This copies forward, so overlap is OK.
+        uint8 i;
+        for (i = 0; i < left; i++)
+        {
+            buffer[i] = buffer[offset + i];
+        }
+        offset = rxChannelOffset[channel] = 0;
+    }
+
+    copyBytes(buffer + offset + left, packet + 1, length);
+    rxChannelBytesLeft[channel] = left + length;
+    return 1;
+}
+
+// Reads bytes from the RX buffer of the given channel.
+static void rxChannelRead(uint8 channel, uint8 XDATA * buffer, uint8 size)
+{
+    copyBytes(buffer, rxChannelBuffer[channel] + rxChannelOffset[channel], size);
+    rxChannelOffset[channel] += size;
+    rxChannelBytesLeft[channel] -= size;
+}
+
+// Processes a channel credit packet from the other Wixel.
+static void receiveChannelCredit(const uint8 XDATA * packet)
+{
+    uint8 i;
+
+    if (packet[0] < 2 + EXTRA_CHANNELS)
+    {
+        return;
+    }
+
+    channelsUsed = 1;
+
+    if (packet[1] != rxChannelEpoch)
+    {
+        // The other Wixel started a new epoch, so it counts the bytes it sends
+        // from 0 starting after this packet.  The data it sent before this packet
+        // is already in our buffers, so start our counts at minus that amount.
+        // Then tell the other Wixel that we are using its new epoch.
+        rxChannelEpoch = packet[1];
+        for (i = 0; i < EXTRA_CHANNELS; i++)
+        {
+            rxChannelConsumed[i] = rxChannelReported[i] = (uint8)(0 - rxChannelBytesLeft[i + 1]);
+        }
+        sendCreditSoon = 1;
+    }
+
+    if (packet[2] == txChannelEpoch && txChannelEpochStarted)
+    {
+        for (i = 0; i < EXTRA_CHANNELS; i++)
+        {
+            txChannelPeerConsumed[i] = packet[3 + i];
+        }
+    }
+}
+
 static void receiveMorePackets(void)
 {
     uint8 XDATA * packet;
 
     if (rxBytesLeft != 0)
     {
-        // There are bytes available.  The higher-level code should
-        // call radioComRxReceiveByte to get them.
+        // There are bytes available in the current radio_link packet.  The
+        // higher-level code should call radioComRxReceiveByte to get them.
         return;
     }
 
@@ -61,9 +235,23 @@ static void receiveMorePackets(void)
     // that contains some information that the higher-level code needs to process.
     while(packet = radioLinkRxCurrentPacket())
     {
-        switch(radioLinkRxCurrentPayloadType())
+        uint8 payloadType = radioLinkRxCurrentPayloadType();
+        switch(payloadType)
         {
         case PAYLOAD_TYPE_DATA:
+            if (rxChannel0Buffered)
+            {
+                if (!rxChannelStore(0, packet))
+                {
+                    // The higher-level code has not read enough of the previous data
+                    // for channel 0 yet.  Channel 0 has no credits (so that it works
+                    // with older versions of this library), so we have to wait.
+                    return;
+                }
+                radioLinkRxDoneWithPacket();
+                break;
+            }
+
             // We received some data.  Populate rxPointer and rxBytesLeft.
             // The data can be retreived with radioComRxAvailable and racioComRxReceiveByte().
 
@@ -75,6 +263,13 @@ static void receiveMorePackets(void)
             return;
 
         case PAYLOAD_TYPE_CONTROL_SIGNALS:
+            if (radioComRxEnforceOrdering && rxChannelBytesLeft[0] != 0)
+            {
+                // The higher-level code has not read the channel 0 data that was
+                // received before this packet.
+                return;
+            }
+
             // We received a command to set the control signals.
             radioComRxSignals = packet[1];
 
@@ -91,6 +286,36 @@ static void receiveMorePackets(void)
             // It was a redundant command so don't do anything special.
             // Keep processing packets.
             break;
+
+        case PAYLOAD_TYPE_CHANNEL_CREDIT:
+            receiveChannelCredit(packet);
+            radioLinkRxDoneWithPacket();
+            break;
+
+        default:
+            if (payloadType >= PAYLOAD_TYPE_FIRST_CHANNEL && payloadType < PAYLOAD_TYPE_FIRST_CHANNEL + EXTRA_CHANNELS)
+            {
+                // We received data for one of the buffered channels.
+                uint8 i = payloadType - PAYLOAD_TYPE_FIRST_CHANNEL;
+
+                // The other Wixel uses channels, so give channel 0 its own buffer too.
+                // (Any channel 0 data before this packet has already been read.)
+                rxChannel0Buffered = 1;
+                channelsUsed = 1;
+
+                if (!rxChannelStore(i + 1, packet))
+                {
+                    // This only happens just after an epoch starts, when some of the
+                    // data in the buffer was sent in the previous epoch.  Wait for
+                    // the higher-level code to read this channel.
+                    return;
+                }
+            }
+
+            // Free the packet so that packets for the other channels
+            // can be processed.  Packets with unknown payload types are discarded.
+            radioLinkRxDoneWithPacket();
+            break;
         }
     }
 }
@@ -103,6 +328,10 @@ static void receiveMorePackets(void)
 uint8 radioComRxAvailable(void)
 {
     receiveMorePackets();
+    if (rxChannel0Buffered)
+    {
+        return rxChannelBytesLeft[0];
+    }
     return rxBytesLeft;
 }
 
@@ -110,7 +339,17 @@ uint8 radioComRxAvailable(void)
 // a non-zero value.
 uint8 radioComRxReceiveByte(void)
 {
-    uint8 tmp = *rxPointer;   // Read a byte from the current RX packet.
+    uint8 tmp;
+
+    if (rxChannel0Buffered)
+    {
+        tmp = rxChannelBuffer[0][rxChannelOffset[0]];
+        rxChannelOffset[0]++;
+        rxChannelBytesLeft[0]--;
+        return tmp;
+    }
+
+    tmp = *rxPointer;         // Read a byte from the current RX packet.
     rxPointer++;              // Update pointer and counter.
     rxBytesLeft--;
 
@@ -122,6 +361,28 @@ uint8 radioComRxReceiveByte(void)
     return tmp;
 }
 
+// Assumption: The user recently called radioComRxAvailable and it returned
+// a value greater than or equal to size.
+void radioComRxReceive(uint8 XDATA * buffer, uint8 size)
+{
+    if (size == 0){ return; }
+
+    if (rxChannel0Buffered)
+    {
+        rxChannelRead(0, buffer, size);
+        return;
+    }
+
+    copyBytes(buffer, rxPointer, size);
+    rxPointer += size;
+    rxBytesLeft -= size;
+
+    if (rxBytesLeft == 0)
+    {
+        radioLinkRxDoneWithPacket();
+    }
+}
+
 uint8 radioComRxControlSignals(void)
 {
     receiveMorePackets();
@@ -138,6 +399,116 @@ static void radioComSendDataNow()
     txBytesLoaded = 0;
 }
 
+// Returns non-zero if a packet that is not full should be sent now,
+// according to the policy described above.
+static uint8 partialPacketReady(uint8 bytesLoaded, uint8 startTime)
+{
+    return bytesLoaded != 0 &&
+        ((bytesLoaded >= radioComTxMinFill && radioLinkTxQueued() <= TX_QUEUE_THRESHOLD) ||
+        (radioComTxMaxDelay != 0 && (uint8)(getMs() - startTime) >= radioComTxMaxDelay));
+}
+
+// Gives free radio_link packet slots to the buffered channels that have
+// data ready, taking turns so that each channel gets its fair share.
+static void radioComSendChannelsNow()
+{
+    uint8 n, i, bytesLoaded;
+    uint8 XDATA * packet;
+
+    txChannelWaiting = 0;
+
+    for (n = 0; n < EXTRA_CHANNELS; n++)
+    {
+        i = txNextChannel + n;
+        if (i >= EXTRA_CHANNELS){ i -= EXTRA_CHANNELS; }
+
+        bytesLoaded = txChannelBytesLoaded[i];
+        if (bytesLoaded != RADIO_LINK_PAYLOAD_SIZE && !partialPacketReady(bytesLoaded, txChannelStartTime[i]))
+        {
+            continue;
+        }
+
+        if (!txChannelEpochStarted || (uint8)(txChannelSent[i] - txChannelPeerConsumed[i]) > RX_CHANNEL_BUFFER_SIZE - bytesLoaded)
+        {
+            // The other Wixel does not have room for this data yet.  Let the
+            // other channels (including channel 0) go ahead.
+            // Until the other Wixel reports counts for our epoch, txChannelPeerConsumed
+            // is 0, so at most RX_CHANNEL_BUFFER_SIZE bytes are sent.
+            continue;
+        }
+
+        if (txBytesLoaded != 0)
+        {
+            // Channel 0 is populating the current radio_link packet,
+            // so send it now to free up the slot.
+            radioComSendDataNow();
+        }
+
+        if (!radioLinkTxAvailable())
+        {
+            // No free slot.  Channel 0 is not allowed to take the next one
+            // (see radioComTxAvailable).
+            txChannelWaiting = 1;
+            return;
+        }
+
+        packet = radioLinkTxCurrentPacket();
+        packet[0] = bytesLoaded;
+        copyBytes(packet + 1, txChannelBuffer[i], bytesLoaded);
+        radioLinkTxSendPacket(PAYLOAD_TYPE_FIRST_CHANNEL + i);
+        txChannelBytesLoaded[i] = 0;
+        txChannelSent[i] += bytesLoaded;
+
+        txNextChannel = i + 1;
+        if (txNextChannel >= EXTRA_CHANNELS){ txNextChannel = 0; }
+    }
+}
+
+// Returns non-zero if the higher-level code has read enough channel data since
+// the last channel credit packet that we should send another one.
+static uint8 channelCreditReady()
+{
+    uint8 i;
+    for (i = 0; i < EXTRA_CHANNELS; i++)
+    {
+        if ((uint8)(rxChannelConsumed[i] - rxChannelReported[i]) >= CREDIT_REPORT_THRESHOLD)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void radioComSendChannelCreditNow()
+{
+    // Assumption: txBytesLoaded is 0 (we are not in the middle of populating a data packet)
+    // Assumption: radioLinkTxAvailable() >= 1
+
+    uint8 XDATA * packet;
+    uint8 i;
+
+    if (!txChannelEpochStarted)
+    {
+        // The other Wixel will count the data we send after this packet from 0.
+        for (i = 0; i < EXTRA_CHANNELS; i++)
+        {
+            txChannelSent[i] = txChannelPeerConsumed[i] = 0;
+        }
+        txChannelEpochStarted = 1;
+    }
+
+    packet = radioLinkTxCurrentPacket();
+    packet[0] = 2 + EXTRA_CHANNELS;
+    packet[1] = txChannelEpoch;
+    packet[2] = rxChannelEpoch;
+    for (i = 0; i < EXTRA_CHANNELS; i++)
+    {
+        packet[3 + i] = rxChannelReported[i] = rxChannelConsumed[i];
+    }
+    sendCreditSoon = 0;
+    radioLinkTxSendPacket(PAYLOAD_TYPE_CHANNEL_CREDIT);
+}
+
 static void radioComSendControlSignalsNow()
 {
     // Assumption: txBytesLoaded is 0 (we are not in the middle of populating a data packet)
@@ -160,6 +531,13 @@ void radioComTxService(void)
         // reset.  We should send the state of the control signals to it.
         radioLinkResetPacketReceived = 0;
         sendSignalsSoon = 1;
+
+        // Our channel byte counts do not match the other device's counts anymore,
+        // so start a new epoch and wait for the other device's new one.
+        txChannelEpoch = (txChannelEpoch + 1) & 0x7F;
+        txChannelEpochStarted = 0;
+        rxChannelEpoch = NO_EPOCH;
+        sendCreditSoon = 1;
     }
 
     if (sendSignalsSoon)
@@ -184,13 +562,30 @@ void radioComTxService(void)
     else
     {
         // We don't need to send control signals ASAP, so we use the normal policy
-        // for sending data: only send a non-full packet if the number of packets
-        // queued in the lower level drops below the TX_QUEUE_THRESHOLD.
+        // for sending data: only send a non-full packet if it has at least
+        // radioComTxMinFill bytes and the number of packets queued in the lower
+        // level drops below the TX_QUEUE_THRESHOLD, or if the oldest byte in it
+        // has been waiting for radioComTxMaxDelay milliseconds.
 
-        if (txBytesLoaded != 0 && radioLinkTxQueued() <= TX_QUEUE_THRESHOLD)
+        if (partialPacketReady(txBytesLoaded, txStartTime))
         {
             radioComSendDataNow();
         }
+
+        if (WAITING_TO_SEND_CREDIT || channelCreditReady())
+        {
+            if (txBytesLoaded != 0)
+            {
+                radioComSendDataNow();
+            }
+
+            if (radioLinkTxAvailable())
+            {
+                radioComSendChannelCreditNow();
+            }
+        }
+
+        radioComSendChannelsNow();
     }
 }
 
@@ -204,6 +599,12 @@ uint8 radioComTxAvailable(void)
         // the plan to ensure that everything is processed in the right order.
         return 0;
     }
+    else if (txChannelWaiting || WAITING_TO_SEND_CREDIT)
+    {
+        // Another channel or a credit packet is waiting for a free radio_link
+        // packet, so let it have the next one.
+        return 0;
+    }
     else
     {
         // Assumption: If txBytesLoaded is non-zero, radioLinkTxAvailable will be non-zero,
@@ -219,6 +620,7 @@ void radioComTxSendByte(uint8 byte)
     if (txBytesLoaded == 0)
     {
         txPointer = packetPointer = radioLinkTxCurrentPacket();
+        txStartTime = (uint8)getMs();
     }
 
     txPointer++;
@@ -231,6 +633,47 @@ void radioComTxSendByte(uint8 byte)
     }
 }
 
+void radioComTxSend(const uint8 XDATA * buffer, uint8 size)
+{
+    uint8 spanSize;
+
+    // Assumption: The user called radioComTxAvailable recently and it returned a value
+    // greater than or equal to size.
+    while(size)
+    {
+        if (txBytesLoaded == 0)
+        {
+            txPointer = packetPointer = radioLinkTxCurrentPacket();
+            txStartTime = (uint8)getMs();
+        }
+
+        // Copy as many bytes as will fit in the current packet.
+        spanSize = RADIO_LINK_PAYLOAD_SIZE - txBytesLoaded;
+        if (spanSize > size){ spanSize = size; }
+
+        copyBytes(txPointer + 1, buffer, spanSize);
+        txPointer += spanSize;
+        txBytesLoaded += spanSize;
+        buffer += spanSize;
+        size -= spanSize;
+
+        if (txBytesLoaded == RADIO_LINK_PAYLOAD_SIZE)
+        {
+            radioComSendDataNow();
+        }
+    }
+}
+
+void radioComTxFlush(void)
+{
+    // Assumption: If txBytesLoaded is non-zero, the current radio_link TX packet
+    // belongs to us so we can send it right away.
+    if (txBytesLoaded != 0)
+    {
+        radioComSendDataNow();
+    }
+}
+
 // If we are in the middle of building a packet, send it.
 void radioComTxControlSignals(uint8 controlSignals)
 {
@@ -241,3 +684,68 @@ void radioComTxControlSignals(uint8 controlSignals)
         radioComTxService();
     }
 }
+
+/** CHANNEL FUNCTIONS *********************************************************/
+
+uint8 radioComChannelRxAvailable(uint8 channel)
+{
+    if (channel == 0)
+    {
+        return radioComRxAvailable();
+    }
+
+    channelsUsed = 1;
+    receiveMorePackets();
+    return rxChannelBytesLeft[channel];
+}
+
+void radioComChannelRxReceive(uint8 channel, uint8 XDATA * buffer, uint8 size)
+{
+    if (channel == 0)
+    {
+        radioComRxReceive(buffer, size);
+        return;
+    }
+
+    // Assumption: size does not exceed the last value returned by radioComChannelRxAvailable(channel).
+    rxChannelRead(channel, buffer, size);
+    rxChannelConsumed[channel - 1] += size;
+}
+
+uint8 radioComChannelTxAvailable(uint8 channel)
+{
+    if (channel == 0)
+    {
+        return radioComTxAvailable();
+    }
+
+    if (sendSignalsSoon)
+    {
+        // See the comment in radioComTxAvailable.
+        return 0;
+    }
+
+    return RADIO_LINK_PAYLOAD_SIZE - txChannelBytesLoaded[channel - 1];
+}
+
+void radioComChannelTxSend(uint8 channel, const uint8 XDATA * buffer, uint8 size)
+{
+    uint8 i;
+
+    if (channel == 0)
+    {
+        radioComTxSend(buffer, size);
+        return;
+    }
+
+    // Assumption: size does not exceed the last value returned by radioComChannelTxAvailable(channel).
+    // The packet will be sent later by radioComTxService.
+    i = channel - 1;
+    channelsUsed = 1;
+    if (txChannelBytesLoaded[i] == 0)
+    {
+        txChannelStartTime[i] = (uint8)getMs();
+    }
+    copyBytes(txChannelBuffer[i] + txChannelBytesLoaded[i], buffer, size);
+    txChannelBytesLoaded[i] += size;
+}
@@ -9,6 +9,17 @@
  *  transmitted by the radio.  A data packet is a piece of data that needs to be sent to the
  *  other device, and it might correspond to several RF packets because there are retries and
  *  ACKs.
+ *
+ *  By default this layer is stop-and-wait: only one data packet is in flight at a time and
+ *  a single sequence bit is used to detect retransmissions.  If RADIO_LINK_WINDOW_SIZE is
+ *  defined (radio_link_window.lib is built that way), this layer is a selective-repeat
+ *  ARQ instead:  up to RADIO_LINK_WINDOW_SIZE packets from the TX ring are sent back-to-back
+ *  in a burst, and every packet we send carries a cumulative ACK plus a bitmap of the
+ *  out-of-order packets we are holding, so the other party only retransmits what was lost.
+ *
+ *  If RADIO_LINK_ADAPT is defined (radio_link_adapt.lib is built that way), every packet
+ *  also carries a link adaptation byte that is used to adjust the transmit power and data
+ *  rate (PHY profile) to the quality of the link.  See the LINK ADAPTATION section below.
  */
 
 #include <radio_link.h>
@@ -24,12 +35,85 @@ int32 CODE param_radio_channel = 128;
 // Compute the max size of on-the-air packets.  This value is stored in the PKTLEN register.
 #define RADIO_MAX_PACKET_SIZE  (RADIO_LINK_PAYLOAD_SIZE + RADIO_LINK_PACKET_HEADER_LENGTH)
 
+#ifdef RADIO_LINK_WINDOW_SIZE
+
+#if RADIO_LINK_WINDOW_SIZE < 2 || RADIO_LINK_WINDOW_SIZE > 8
+#error "RADIO_LINK_WINDOW_SIZE must be between 2 and 8 (half of the 4-bit sequence number space)."
+#endif
+
+// In windowed mode, the link layer adds a three byte header to the beginning of each packet.
+#define RADIO_LINK_BASE_HEADER_LENGTH 3
+
+#else
+
 // The link layer will add a one byte header to the beginning of each packet.
-#define RADIO_LINK_PACKET_HEADER_LENGTH 1
+#define RADIO_LINK_BASE_HEADER_LENGTH 1
+
+#endif
+
+#ifdef RADIO_LINK_ADAPT
+// The link adaptation byte comes after the other header bytes.
+#define RADIO_LINK_PACKET_HEADER_LENGTH (RADIO_LINK_BASE_HEADER_LENGTH + 1)
+#define RADIO_LINK_PACKET_ADAPT_OFFSET  RADIO_LINK_PACKET_HEADER_LENGTH
+#else
+#define RADIO_LINK_PACKET_HEADER_LENGTH RADIO_LINK_BASE_HEADER_LENGTH
+#endif
+
+#if RADIO_MAX_PACKET_SIZE > 255
+#error "RADIO_LINK_PAYLOAD_SIZE is too big: packets can have at most 255 bytes."
+#endif
+
+// The number of RX packet buffers.  An app can change this by defining it in
+// the APP_C_FLAGS of its options.mk (see apps.mk).  The default number of TX
+// packet buffers is in radio_link.h, because radio_message.h needs it too.
+#ifndef RADIO_LINK_RX_PACKET_COUNT
+#define RADIO_LINK_RX_PACKET_COUNT 3
+#endif
+
+#if RADIO_LINK_RX_PACKET_COUNT < 3 || RADIO_LINK_RX_PACKET_COUNT > 128
+#error "RADIO_LINK_RX_PACKET_COUNT must be between 3 and 128."
+#endif
+
+// The TX indices are wrapped with a mask, so the TX ring must be a power of 2.
+#if RADIO_LINK_TX_PACKET_COUNT < 2 || RADIO_LINK_TX_PACKET_COUNT > 128 || (RADIO_LINK_TX_PACKET_COUNT & (RADIO_LINK_TX_PACKET_COUNT - 1))
+#error "RADIO_LINK_TX_PACKET_COUNT must be a power of 2 between 2 and 128."
+#endif
+
+#if defined(RADIO_LINK_WINDOW_SIZE) && RADIO_LINK_TX_PACKET_COUNT <= RADIO_LINK_WINDOW_SIZE
+#error "RADIO_LINK_TX_PACKET_COUNT must be bigger than RADIO_LINK_WINDOW_SIZE."
+#endif
 
 #define RADIO_LINK_PACKET_LENGTH_OFFSET 0
 #define RADIO_LINK_PACKET_TYPE_OFFSET   1
 
+#ifdef RADIO_LINK_WINDOW_SIZE
+// Windowed mode header bytes:
+// The SEQ byte holds the sequence number of the data in this packet (bits 7:4) and the
+// sequence number that the sender of this packet expects to receive next (bits 3:0), which
+// acknowledges every packet before it.
+// The ACK byte holds a "more packets follow" flag (bit 7), the number of data packets the
+// sender of this packet can accept starting at ack (bits 6:4, its receive credits), and a
+// bitmap of out-of-order packets the sender of this packet has received and is holding
+// (bit i means sequence number ack+1+i was received).
+#define RADIO_LINK_PACKET_SEQ_OFFSET    2
+#define RADIO_LINK_PACKET_ACK_OFFSET    3
+
+#define RADIO_LINK_SEQ_MASK            15
+#define RADIO_LINK_ACK_MORE            (1 << 7)
+#define RADIO_LINK_ACK_CREDIT_BIT_OFFSET 4
+#define RADIO_LINK_ACK_CREDIT_MASK     0b01110000
+#define RADIO_LINK_ACK_HELD_MASK       0x0F
+#else
+// In stop-and-wait mode there is only one credit, so it is carried in a flag in the type byte.
+// The flag is set when the sender of this packet has no RX buffer for another data packet.
+// (It is inverted so that older firmware, which always sends 0, never blocks us.)
+#define PACKET_FLAG_RX_FULL  (1 << 5)
+#endif
+
+// How long to wait, in units of 0.922 ms, for the other party to advertise credit before
+// we send it a data packet anyway.  This handles the case where its window update was lost.
+#define RADIO_LINK_PERSIST_TIMEOUT 250
+
 #define RADIO_LINK_PAYLOAD_TYPE_BIT_OFFSET 1
 #define RADIO_LINK_PAYLOAD_TYPE_MASK       0b00011110
 
@@ -57,18 +141,18 @@ int32 CODE param_radio_channel = 128;
  *                0 |                1 | rxBuffer[0]
  *                0 |                2 | rxBuffer[0 and 1]
  */
-#define RX_PACKET_COUNT  3
+#define RX_PACKET_COUNT  RADIO_LINK_RX_PACKET_COUNT
 static volatile uint8 XDATA radioLinkRxPacket[RX_PACKET_COUNT][1 + RADIO_MAX_PACKET_SIZE + 2];  // The first byte is the length, 2nd byte is link header.
 volatile uint8 DATA radioLinkRxMainLoopIndex = 0;   // The index of the next rxBuffer to read from the main loop.
 volatile uint8 DATA radioLinkRxInterruptIndex = 0;  // The index of the next rxBuffer to write to when a packet comes from the radio.
 
 /* txPackets are handled similarly */
-#define TX_PACKET_COUNT 16
+#define TX_PACKET_COUNT RADIO_LINK_TX_PACKET_COUNT
 static volatile uint8 XDATA radioLinkTxPacket[TX_PACKET_COUNT][1 + RADIO_MAX_PACKET_SIZE];  // The first byte is the length, 2nd byte is link header.
 volatile uint8 DATA radioLinkTxMainLoopIndex = 0;   // The index of the next txPacket to write to in the main loop.
 volatile uint8 DATA radioLinkTxInterruptIndex = 0;  // The index of the current txPacket we are trying to send on the radio.
 
-uint8 XDATA shortTxPacket[2];
+uint8 XDATA shortTxPacket[1 + RADIO_LINK_PACKET_HEADER_LENGTH];
 
 // The number of times the current TX packet has been transmitted.
 // Does NOT overflow.  If we have transmitting the current packet more than 255
@@ -78,6 +162,20 @@ uint8 DATA radioLinkTxCurrentPacketTries = 0;
 static volatile BIT sendingReset = 0;
 static volatile BIT acceptAnySequenceBit = 0;
 
+/* FLOW CONTROL VARIABLES *****************************************************/
+/* Every packet except Reset packets carries the number of data packets its sender
+   can accept (its receive credits).  We do not send data packets that the other
+   party has told us it cannot accept; instead we wait for it to advertise more
+   credit, which it does as soon as its main loop frees an RX buffer.  */
+
+// The number of data packets the other party told us it can accept.
+// Only used in the ISR.
+static uint8 DATA txCredits;
+
+// 1 if the last packet we sent told the other party we had no room for data.
+// The main loop uses this to decide whether the ISR needs to send a window update.
+static volatile BIT rxWindowClosed = 0;
+
 volatile BIT radioLinkResetPacketReceived;
 
 /* SEQUENCING VARIABLES *******************************************************/
@@ -95,11 +193,357 @@ static volatile BIT rxSequenceBit;
 // send.
 static volatile BIT txSequenceBit;
 
+#ifdef RADIO_LINK_WINDOW_SIZE
+/* In windowed mode, each data packet has a 4-bit sequence number instead.  */
+
+// The sequence number of the packet at radioLinkTxInterruptIndex (the oldest packet that
+// has not been acknowledged yet).  Only used in the ISR.
+static uint8 DATA txBaseSeq;
+
+// Bit i is set if the packet at radioLinkTxInterruptIndex + i has been acknowledged
+// selectively and does not need to be retransmitted.  Only used in the ISR.
+static uint8 DATA txAckedMask;
+
+// The offset (from radioLinkTxInterruptIndex) of the packet most recently transmitted.
+static uint8 DATA txBurstOffset;
+
+// 1 if the packet most recently transmitted told the other party that more packets follow.
+static volatile BIT txBurstMore;
+
+// The sequence number of the next packet we expect to receive in order.
+static uint8 DATA rxExpectedSeq;
+
+// Bit i is set if the packet with sequence number rxExpectedSeq+1+i has been received
+// out-of-order and is being held in radioLinkRxPacket[radioLinkRxInterruptIndex+1+i].
+static uint8 DATA rxHeldMask;
+
+// 1 if we received data that we have not acknowledged yet.
+static volatile BIT rxAckPending;
+
+// 1 if we are listening for the rest of a burst from the other party, so an
+// RX timeout does not mean that our own packets were lost.
+static volatile BIT rxWaitingForBurst;
+#endif
+
 
 /* GENERAL VARIABLES **********************************************************/
 
 volatile BIT radioLinkActivityOccurred;
 
+/* LINK ADAPTATION ************************************************************/
+/* In radio_link_adapt.lib, every packet except Reset packets carries a link
+   adaptation byte.  Bits 3:0 tell the other party how strong its packets are when
+   they get to us, so it can turn its transmit power down when there is plenty of
+   margin and up again when there is not.  Bits 7:6 hold a PHY profile (see
+   radioSetProfile).
+
+   Both parties must use the same profile, so changing it takes a handshake:
+   one party sends packets with ADAPT_SWITCH_REQUEST set and the new profile.
+   The other party answers with ADAPT_SWITCH_ACK and the same profile, and
+   switches as soon as that answer has been transmitted.  The first party switches
+   when it receives the answer.  If the answer is lost, the parties end up on
+   different profiles, so after ADAPT_SCAN_TRIES failed tries in a row we move on
+   to the next profile until we find the other party again.
+
+   The profile is chosen from the error rate and the RSSI measured by both
+   parties.  When the link is good we first go to a faster profile and then, once
+   we are at the fastest profile, turn down the power.  When the link gets worse
+   we first turn the power back up and then go to a slower profile.  The link
+   uses the slower of the profiles that the two parties want.  */
+
+#ifdef RADIO_LINK_ADAPT
+
+#define ADAPT_PROFILE_BIT_OFFSET  6
+#define ADAPT_PROFILE_MASK        (3 << 6)
+#define ADAPT_SWITCH_REQUEST      (1 << 5)
+#define ADAPT_SWITCH_ACK          (1 << 4)
+#define ADAPT_RSSI_MASK           0x0F
+
+// Error rates (0-255) above which the link is considered bad and below which it is
+// considered good.
+#define ADAPT_ERROR_HIGH   96
+#define ADAPT_ERROR_LOW    16
+
+// RSSI levels (dBm) below which the margin is too small and above which there is
+// margin to spare.
+#define ADAPT_RSSI_LOW    -80
+#define ADAPT_RSSI_HIGH   -60
+
+// The number of packets to receive after a change before making another one, so
+// the statistics have time to reflect it.
+#define ADAPT_HOLDOFF      32
+
+// The number of failed tries in a row after which we assume the other party is on
+// another profile.
+#define ADAPT_SCAN_TRIES   8
+
+// PA_TABLE0 values for each power level, roughly 4 dB apart.  Level 0 is the
+// setting used by radioRegistersInit.
+#define ADAPT_POWER_LEVELS 6
+static uint8 CODE adaptPaTable[ADAPT_POWER_LEVELS] = { 0xFE, 0xA9, 0x6E, 0xC6, 0x55, 0x46 };
+
+volatile int8 radioLinkAdaptRssi = 0;
+volatile uint8 radioLinkAdaptLqi = 0;
+volatile int8 radioLinkAdaptPeerRssi = 0;
+volatile uint8 radioLinkAdaptErrorRate = 0;
+volatile uint8 radioLinkAdaptPowerLevel = 0;
+
+static uint8 DATA adaptHoldoff;
+static uint8 DATA adaptFailures;       // The number of failed tries since the last good packet.
+static uint8 DATA adaptPeerDesire;     // The profile the other party wants to use.
+static uint8 DATA adaptRequest;        // The profile we asked to switch to, if adaptRequestPending.
+static BIT adaptRequestPending = 0;
+static uint8 DATA adaptAckProfile;     // The profile the other party asked to switch to, if adaptAckPending.
+static BIT adaptAckPending = 0;
+static BIT adaptSwitchOnTx = 0;        // 1 iff we should switch to adaptAckProfile after this TX.
+
+static void adaptSetPower(uint8 level)
+{
+    radioLinkAdaptPowerLevel = level;
+    PA_TABLE0 = adaptPaTable[level];
+}
+
+// Switches to the given profile and starts over with full power and fresh statistics.
+static void adaptSetProfile(uint8 profile)
+{
+    radioSetProfile(profile);
+    adaptSetPower(0);
+    radioLinkAdaptErrorRate = 0;
+    adaptPeerDesire = profile;
+    adaptRequestPending = 0;
+    adaptAckPending = 0;
+    adaptSwitchOnTx = 0;
+    adaptHoldoff = ADAPT_HOLDOFF;
+}
+
+static void adaptInit()
+{
+    adaptSetProfile(RADIO_PROFILE_DEFAULT);
+}
+
+// Updates the moving average of the error rate with a weight of 1/8.
+static void adaptRecord(BIT success)
+{
+    uint8 rate = radioLinkAdaptErrorRate;
+    rate -= rate >> 3;
+    if (!success)
+    {
+        rate += 31;
+    }
+    radioLinkAdaptErrorRate = rate;
+}
+
+// Returns the profile we want to use, based on how well we receive the other party.
+static uint8 adaptDesiredProfile()
+{
+    uint8 profile = radioGetProfile();
+
+    if (radioLinkAdaptPowerLevel != 0)
+    {
+        // We are still turning the power down, so we must be at the fastest profile
+        // already and the link is good.
+        return profile;
+    }
+
+    if (radioLinkAdaptErrorRate > ADAPT_ERROR_HIGH && profile > 0)
+    {
+        return profile - 1;
+    }
+
+    if (radioLinkAdaptErrorRate < ADAPT_ERROR_LOW && radioLinkAdaptRssi > ADAPT_RSSI_HIGH &&
+        profile < RADIO_PROFILE_COUNT - 1)
+    {
+        return profile + 1;
+    }
+
+    return profile;
+}
+
+// Decides whether to change the power or the profile.  Called after every good packet.
+static void adaptDecide()
+{
+    uint8 current = radioGetProfile();
+    uint8 target;
+
+    if (adaptHoldoff)
+    {
+        adaptHoldoff--;
+        return;
+    }
+
+    // Transmit power: this only depends on how well the other party receives us.
+    if (radioLinkAdaptPeerRssi != 0)
+    {
+        if ((radioLinkAdaptPeerRssi < ADAPT_RSSI_LOW || radioLinkAdaptErrorRate > ADAPT_ERROR_HIGH) &&
+            radioLinkAdaptPowerLevel > 0)
+        {
+            adaptSetPower(radioLinkAdaptPowerLevel - 1);
+            adaptHoldoff = ADAPT_HOLDOFF;
+            return;
+        }
+
+        if (radioLinkAdaptPeerRssi > ADAPT_RSSI_HIGH && radioLinkAdaptErrorRate < ADAPT_ERROR_LOW &&
+            current == RADIO_PROFILE_COUNT - 1 && radioLinkAdaptPowerLevel < ADAPT_POWER_LEVELS - 1)
+        {
+            adaptSetPower(radioLinkAdaptPowerLevel + 1);
+            adaptHoldoff = ADAPT_HOLDOFF;
+            return;
+        }
+    }
+
+    // Profile: use the slower of the profiles that we and the other party want.
+    target = adaptDesiredProfile();
+    if (adaptPeerDesire < target)
+    {
+        target = adaptPeerDesire;
+    }
+
+    if (target != current && !adaptAckPending)
+    {
+        adaptRequest = target;
+        adaptRequestPending = 1;
+    }
+    else
+    {
+        adaptRequestPending = 0;
+    }
+}
+
+// Fills in the link adaptation byte of a packet we are about to send.
+static void adaptFillHeader(uint8 XDATA * packet)
+{
+    int8 rssi = radioLinkAdaptRssi;
+    uint8 adapt;
+
+    if (adaptAckPending)
+    {
+        adapt = (adaptAckProfile << ADAPT_PROFILE_BIT_OFFSET) | ADAPT_SWITCH_ACK;
+        adaptSwitchOnTx = 1;
+    }
+    else if (adaptRequestPending)
+    {
+        adapt = (adaptRequest << ADAPT_PROFILE_BIT_OFFSET) | ADAPT_SWITCH_REQUEST;
+    }
+    else
+    {
+        adapt = adaptDesiredProfile() << ADAPT_PROFILE_BIT_OFFSET;
+    }
+
+    // Bits 3:0 are the RSSI in steps of 4 dB (0 means we have not received anything).
+    if (rssi != 0)
+    {
+        if (rssi < -102)
+        {
+            rssi = -102;
+        }
+        else if (rssi > -46)
+        {
+            rssi = -46;
+        }
+        adapt |= (uint8)(rssi + 106) >> 2;
+    }
+
+    packet[RADIO_LINK_PACKET_ADAPT_OFFSET] = adapt;
+}
+
+// Called when a packet with a good CRC is received, before anything else looks at it.
+static void adaptRxPacket(uint8 XDATA * packet)
+{
+    uint8 length = packet[RADIO_LINK_PACKET_LENGTH_OFFSET];
+    uint8 adapt, profile;
+    int8 rssi;
+
+    // The radio appends the RSSI and LQI of the packet after the data.
+    rssi = ((int8)packet[1 + length]) / 2 - radioRssiOffset;
+    if (radioLinkAdaptRssi == 0)
+    {
+        radioLinkAdaptRssi = rssi;
+        radioLinkAdaptLqi = packet[2 + length] & 0x7F;
+    }
+    else
+    {
+        radioLinkAdaptRssi += (rssi - radioLinkAdaptRssi) / 4;
+        radioLinkAdaptLqi += ((int8)(packet[2 + length] & 0x7F) - (int8)radioLinkAdaptLqi) / 4;
+    }
+    adaptRecord(1);
+    adaptFailures = 0;
+
+    if ((packet[RADIO_LINK_PACKET_TYPE_OFFSET] & PACKET_TYPE_MASK) == PACKET_TYPE_RESET ||
+        length < RADIO_LINK_PACKET_HEADER_LENGTH)
+    {
+        // This packet has no link adaptation byte.
+        return;
+    }
+
+    adapt = packet[RADIO_LINK_PACKET_ADAPT_OFFSET];
+    profile = adapt >> ADAPT_PROFILE_BIT_OFFSET;
+    radioLinkAdaptPeerRssi = (adapt & ADAPT_RSSI_MASK) ? (int8)((adapt & ADAPT_RSSI_MASK) << 2) - 106 : 0;
+
+    if (adapt & ADAPT_SWITCH_ACK)
+    {
+        if (adaptRequestPending && profile == adaptRequest)
+        {
+            // The other party agreed and has switched by now, so we switch too.
+            adaptSetProfile(profile);
+        }
+        return;
+    }
+
+    if (adapt & ADAPT_SWITCH_REQUEST)
+    {
+        if (profile != radioGetProfile() && profile < RADIO_PROFILE_COUNT)
+        {
+            // The other party wants to switch.  Tell it we agree in the next packet
+            // we send and switch after that.
+            adaptAckProfile = profile;
+            adaptAckPending = 1;
+            adaptRequestPending = 0;
+        }
+        return;
+    }
+
+    if (profile < RADIO_PROFILE_COUNT)
+    {
+        adaptPeerDesire = profile;
+    }
+    adaptDecide();
+}
+
+// Called when a packet has been transmitted.
+static void adaptTxDone()
+{
+    if (adaptSwitchOnTx)
+    {
+        adaptSetProfile(adaptAckProfile);
+    }
+}
+
+// Called when we retransmit because we did not get an acknowledgment.
+static void adaptTxFailed()
+{
+    adaptRecord(0);
+
+    if (++adaptFailures >= ADAPT_SCAN_TRIES)
+    {
+        adaptFailures = 0;
+
+        // We might have lost the other party because it switched to a different
+        // profile than us, so try the next one.
+        adaptSetProfile((radioGetProfile() + 1) % RADIO_PROFILE_COUNT);
+    }
+}
+
+#else
+
+#define adaptInit()
+#define adaptRecord(success)
+#define adaptFillHeader(packet)
+#define adaptRxPacket(packet)
+#define adaptTxDone()
+#define adaptTxFailed()
+
+#endif
+
 /* GENERAL FUNCTIONS **********************************************************/
 
 void radioLinkInit()
@@ -110,9 +554,20 @@ void radioLinkInit()
 
     txSequenceBit = 0;
 
+    txCredits = 1;
+
+#ifdef RADIO_LINK_WINDOW_SIZE
+    rxExpectedSeq = 0;
+    rxHeldMask = 0;
+    txBaseSeq = 0;
+    txAckedMask = 0;
+#endif
+
     PKTLEN = RADIO_MAX_PACKET_SIZE;
     CHANNR = param_radio_channel;
 
+    adaptInit();
+
     acceptAnySequenceBit = 1;
     radioMacInit();
 
@@ -121,18 +576,110 @@ void radioLinkInit()
     radioMacStrobe();
 }
 
-// Returns a random delay in units of 0.922 ms (the same units of radioMacRx).
-// This is used to decide how long to wait before retransmitting.
-// This is used to decide when to next transmit a queued data packet.
-// If we have already tried sending this packet many times, then this function
-// will return a much longer delay, in order to avoid overcrowding the airwaves for
-// no reason.  This is similar to the idea of exponential backoff used in other
-// communications protocols such as Ethernet:
+/* RETRANSMISSION TIMER *******************************************************/
+/* We measure the round-trip time from transmitting a data packet until we receive
+   its ACK, and keep a smoothed RTT and RTT variance the same way TCP does
+   (RFC 6298, Jacobson/Karels).  Samples are only taken from packets that were
+   transmitted once (Karn's algorithm), because otherwise we can't tell which
+   transmission the ACK is for.  The timeout is SRTT + 4*RTTVAR.  Every time we
+   retransmit because that timeout expired, the timeout doubles (exponential
+   backoff), until an ACK arrives.  */
+
+// The shortest and longest retransmission timeouts, in units of 0.922 ms.
+#define RADIO_LINK_MIN_RTO  1
+#define RADIO_LINK_MAX_RTO  250
+
+// Smoothed RTT in units of 1/8 ms and RTT variance in units of 1/4 ms.
+// These are only valid if rttMeasured is 1.
+static uint16 rttSmoothed;
+static uint16 rttVariance;
+static BIT rttMeasured = 0;
+
+// The current retransmission timeout before backoff, in units of 0.922 ms.
+static uint8 rttTimeout = RADIO_LINK_MIN_RTO;
+
+// The number of times the retransmission timeout has doubled.
+static uint8 DATA rttBackoff = 0;
+
+// The low byte of timeMs when we transmitted the packet we are timing.
+static uint8 DATA rttTxTime;
+
+// This is defined in time.c.  The RTT functions are called from the RF ISR, so we read
+// it directly instead of calling getMs, which is not reentrant.  Only the low byte is
+// used, and reading one byte is atomic.
+extern PDATA volatile uint32 timeMs;
+
+// Called when we transmit the first packet in the TX queue.
+static void rttPacketSent()
+{
+    rttTxTime = (uint8)timeMs;
+}
+
+// Called when the first packet in the TX queue is acknowledged, before
+// radioLinkTxCurrentPacketTries is reset.
+static void rttPacketAcked()
+{
+    if (radioLinkTxCurrentPacketTries == 1)
+    {
+        uint8 sample = (uint8)timeMs - rttTxTime;
+        uint16 timeout;
+
+        if (!rttMeasured)
+        {
+            rttSmoothed = sample << 3;
+            rttVariance = sample << 1;
+            rttMeasured = 1;
+        }
+        else
+        {
+            int16 error = sample - (rttSmoothed >> 3);
+            rttSmoothed += error;
+            if (error < 0)
+            {
+                error = -error;
+            }
+            rttVariance += error - (rttVariance >> 2);
+        }
+
+        // 1 ms is about 1.08 units of 0.922 ms, which is close enough.
+        timeout = (rttSmoothed >> 3) + rttVariance;
+        if (timeout < RADIO_LINK_MIN_RTO)
+        {
+            timeout = RADIO_LINK_MIN_RTO;
+        }
+        else if (timeout > RADIO_LINK_MAX_RTO)
+        {
+            timeout = RADIO_LINK_MAX_RTO;
+        }
+        rttTimeout = timeout;
+    }
+
+    rttBackoff = 0;
+}
+
+// Called when we gave up waiting for an ACK and are about to retransmit.
+static void rttTimeoutExpired()
+{
+    if ((rttTimeout << rttBackoff) < RADIO_LINK_MAX_RTO)
+    {
+        rttBackoff++;
+    }
+}
+
+// Returns a delay in units of 0.922 ms (the same units of radioMacRx).
+// This is used to decide how long to wait for an ACK before retransmitting.
+// The delay is the retransmission timeout with exponential backoff applied,
+// plus a small random amount so that two Wixels retrying at the same time
+// do not keep colliding:
 // http://en.wikipedia.org/wiki/Exponential_backoff
 static uint8 randomTxDelay()
 {
-    // 200 and 250 were chosen arbitrarily.
-    return (radioLinkTxCurrentPacketTries > 200 ? 250 : 1) + (randomNumber() & 3);
+    uint16 delay = (uint16)rttTimeout << rttBackoff;
+    if (delay > RADIO_LINK_MAX_RTO)
+    {
+        delay = RADIO_LINK_MAX_RTO;
+    }
+    return delay + (randomNumber() & 3);
 }
 
 BIT radioLinkConnected()
@@ -213,14 +760,81 @@ void radioLinkRxDoneWithPacket(void)
     {
         radioLinkRxMainLoopIndex++;
     }
+
+    if (rxWindowClosed)
+    {
+        // We told the other party we had no room, so make sure the ISR runs soon
+        // and tells it that there is room now.
+        radioMacStrobe();
+    }
 }
 
 /* FUNCTIONS CALLED IN RF_ISR *************************************************/
 
+
+#ifdef RADIO_LINK_WINDOW_SIZE
+
+// Returns the number of queued TX packets that are inside the window.
+static uint8 txWindowCount()
+{
+    uint8 queued = radioLinkTxQueued();
+    return queued < RADIO_LINK_WINDOW_SIZE ? queued : RADIO_LINK_WINDOW_SIZE;
+}
+
+// Returns the number of packets in the window that the other party has credit for.
+static uint8 txSendLimit()
+{
+    uint8 count = txWindowCount();
+    return count < txCredits ? count : txCredits;
+}
+
+// Returns the offset of the first packet we may send, starting at the given offset,
+// that has not been acknowledged yet.  Returns txSendLimit() if there is none.
+static uint8 txNextUnacked(uint8 offset)
+{
+    uint8 limit = txSendLimit();
+    while (offset < limit && (txAckedMask >> offset) & 1)
+    {
+        offset++;
+    }
+    return offset < limit ? offset : limit;
+}
+
+// Returns the number of RX packet buffers not owned by the main loop (including the one
+// the ISR is receiving into).
+static uint8 rxFreeCount()
+{
+    uint8 owned = radioLinkRxInterruptIndex - radioLinkRxMainLoopIndex;
+    if (owned >= RX_PACKET_COUNT)
+    {
+        owned += RX_PACKET_COUNT;   // The subtraction above underflowed.
+    }
+    return RX_PACKET_COUNT - owned;
+}
+
+// Fills in the SEQ and ACK bytes that tell the other party which packets we have received
+// and how many more we can accept.
+static void txFillAck(uint8 XDATA * packet)
+{
+    // One free buffer always stays with the ISR, so it does not count as credit.
+    uint8 credits = rxFreeCount() - 1;
+    if (credits > (RADIO_LINK_ACK_CREDIT_MASK >> RADIO_LINK_ACK_CREDIT_BIT_OFFSET))
+    {
+        // The credit field only has 3 bits; bit 7 of the ACK byte is RADIO_LINK_ACK_MORE.
+        credits = RADIO_LINK_ACK_CREDIT_MASK >> RADIO_LINK_ACK_CREDIT_BIT_OFFSET;
+    }
+
+    packet[RADIO_LINK_PACKET_SEQ_OFFSET] = (packet[RADIO_LINK_PACKET_SEQ_OFFSET] & ~RADIO_LINK_SEQ_MASK) | rxExpectedSeq;
+    packet[RADIO_LINK_PACKET_ACK_OFFSET] = (credits << RADIO_LINK_ACK_CREDIT_BIT_OFFSET) | rxHeldMask;
+    rxWindowClosed = (credits == 0);
+    rxAckPending = 0;
+}
+
 static void txResetPacket()
 {
     shortTxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] = 1;
     shortTxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] = PACKET_TYPE_RESET;
+    txBurstMore = 0;
     radioMacTx(shortTxPacket);
     if (radioLinkTxCurrentPacketTries < 255)
     {
@@ -228,11 +842,393 @@ static void txResetPacket()
     }
 }
 
+// Sends an ACK or NAK with no data.
+static void txShortPacket(uint8 packetType)
+{
+    shortTxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] = RADIO_LINK_PACKET_HEADER_LENGTH;
+    shortTxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] = packetType;
+    shortTxPacket[RADIO_LINK_PACKET_SEQ_OFFSET] = 0;
+    txFillAck(shortTxPacket);
+    adaptFillHeader(shortTxPacket);
+    txBurstMore = 0;
+    radioMacTx(shortTxPacket);
+}
+
+// Sends the data packet at the given offset from radioLinkTxInterruptIndex.
+static void txDataPacket(uint8 offset)
+{
+    uint8 XDATA * packet = radioLinkTxPacket[(radioLinkTxInterruptIndex + offset) & (TX_PACKET_COUNT - 1)];
+
+    // Until we have received something from the other party, our ACK fields are meaningless,
+    // so we send a Ping instead of an ACK.
+    packet[RADIO_LINK_PACKET_TYPE_OFFSET] = (packet[RADIO_LINK_PACKET_TYPE_OFFSET] & RADIO_LINK_PAYLOAD_TYPE_MASK) |
+            (acceptAnySequenceBit ? PACKET_TYPE_PING : PACKET_TYPE_ACK);
+    packet[RADIO_LINK_PACKET_SEQ_OFFSET] = (txBaseSeq + offset) << 4;
+    txFillAck(packet);
+
+    txBurstOffset = offset;
+    txBurstMore = txNextUnacked(offset + 1) < txSendLimit();
+    if (txBurstMore)
+    {
+        packet[RADIO_LINK_PACKET_ACK_OFFSET] |= RADIO_LINK_ACK_MORE;
+    }
+    adaptFillHeader(packet);
+
+    radioMacTx(packet);
+
+    if (offset == 0)
+    {
+        rttPacketSent();
+        if (radioLinkTxCurrentPacketTries < 255)
+        {
+            radioLinkTxCurrentPacketTries++;
+        }
+    }
+}
+
+// Starts a burst: sends the first unacknowledged packet in the window.
+// Returns 0 if there was nothing to send.
+static BIT txStartBurst()
+{
+    uint8 offset = txNextUnacked(0);
+    if (offset == txSendLimit())
+    {
+        return 0;
+    }
+    txDataPacket(offset);
+    return 1;
+}
+
+static void takeInitiative()
+{
+    if (sendingReset)
+    {
+        // Try to send a reset packet.
+        txResetPacket();
+        radioLinkActivityOccurred = 1;
+    }
+    else if (txStartBurst())
+    {
+        // We are sending data packets (which also acknowledge anything we received).
+        radioLinkActivityOccurred = 1;
+    }
+    else if (rxAckPending || (rxWindowClosed && rxFreeCount() > 1))
+    {
+        // Either the other party's burst ended without its last packet reaching us, so we
+        // acknowledge what we did get, or the main loop freed an RX buffer after we told the
+        // other party we had no room, so we send a window update.
+        txShortPacket(PACKET_TYPE_ACK);
+    }
+    else if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex)
+    {
+        // We have data but the other party has no room for it.  Wait for it to advertise
+        // credit, but not forever in case its window update gets lost.
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], RADIO_LINK_PERSIST_TIMEOUT);
+    }
+    else
+    {
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], 0);
+    }
+}
+
+// Processes the acknowledgment fields of a packet from the other party.
+static void rxProcessAck(uint8 XDATA * packet)
+{
+    uint8 count = txWindowCount();
+    uint8 acked = ((packet[RADIO_LINK_PACKET_SEQ_OFFSET] & RADIO_LINK_SEQ_MASK) - txBaseSeq) & RADIO_LINK_SEQ_MASK;
+
+    if (acked > count)
+    {
+        // This acknowledges packets we have not sent, so it must be stale.  Ignore it.
+        return;
+    }
+
+    if (acked)
+    {
+        // Give ownership of the acknowledged TX packets back to the main loop.
+        radioLinkTxInterruptIndex = (radioLinkTxInterruptIndex + acked) & (TX_PACKET_COUNT - 1);
+        txBaseSeq = (txBaseSeq + acked) & RADIO_LINK_SEQ_MASK;
+        txAckedMask >>= acked;
+        count -= acked;
+
+        // Reset the transmission counter.
+        rttPacketAcked();
+        radioLinkTxCurrentPacketTries = 0;
+    }
+
+    // Record the packets the other party is holding out of order, so we don't resend them.
+    txAckedMask |= (packet[RADIO_LINK_PACKET_ACK_OFFSET] & RADIO_LINK_ACK_HELD_MASK) << 1;
+    txAckedMask &= (1 << count) - 1;
+}
+
+// Converts a received RF packet into the format read by the main loop.
+static void rxPreparePacket(uint8 XDATA * packet)
+{
+    // Extract the payload type.
+    uint8 payloadType = (packet[RADIO_LINK_PACKET_TYPE_OFFSET] & RADIO_LINK_PAYLOAD_TYPE_MASK) >> RADIO_LINK_PAYLOAD_TYPE_BIT_OFFSET;
+
+    // Set length byte that will be read by the higher-level code.
+    // (This overrides the last byte of the header.)
+    packet[RADIO_LINK_PACKET_HEADER_LENGTH] = packet[RADIO_LINK_PACKET_LENGTH_OFFSET] - RADIO_LINK_PACKET_HEADER_LENGTH;
+
+    // Set the payload type byte which will be read by radioLinkRxCurrentPayloadType().
+    // (This overrides the RF packet length.)
+    packet[0] = payloadType;
+}
+
+static uint8 rxIndexPlus(uint8 offset)
+{
+    uint8 index = radioLinkRxInterruptIndex + offset;
+    return index >= RX_PACKET_COUNT ? index - RX_PACKET_COUNT : index;
+}
+
+// Accepts a data packet into the RX ring if we can.
+static void rxDataPacket(uint8 XDATA * packet)
+{
+    uint8 seq = packet[RADIO_LINK_PACKET_SEQ_OFFSET] >> 4;
+    uint8 offset;
+
+    if (acceptAnySequenceBit)
+    {
+        // We don't know what the other party's sequence number is yet, so accept this one.
+        rxExpectedSeq = seq;
+        rxHeldMask = 0;
+    }
+
+    offset = (seq - rxExpectedSeq) & RADIO_LINK_SEQ_MASK;
+
+    if (offset == 0)
+    {
+        // This is the packet we were waiting for.  We can give it to the main loop only
+        // if that leaves a buffer for the ISR to receive into.
+        if (rxFreeCount() < 2)
+        {
+            return;
+        }
+
+        acceptAnySequenceBit = 0;
+        rxPreparePacket(packet);
+        radioLinkRxInterruptIndex = rxIndexPlus(1);
+        rxExpectedSeq = (rxExpectedSeq + 1) & RADIO_LINK_SEQ_MASK;
+
+        // Deliver any held packets that are now in order.  They are already in
+        // the right buffers.  (Bit i of rxHeldMask refers to rxExpectedSeq+i here.)
+        while (rxHeldMask & 1)
+        {
+            rxHeldMask >>= 1;
+            radioLinkRxInterruptIndex = rxIndexPlus(1);
+            rxExpectedSeq = (rxExpectedSeq + 1) & RADIO_LINK_SEQ_MASK;
+        }
+        rxHeldMask >>= 1;
+    }
+    else if (offset < RADIO_LINK_WINDOW_SIZE && offset <= 4 && !((rxHeldMask >> (offset - 1)) & 1))
+    {
+        // This packet is ahead of the one we are waiting for.  Hold it in the buffer
+        // where it will need to be when the missing packets arrive, but only if the
+        // packets before it would still leave a buffer for the ISR.
+        if (offset + 2 <= rxFreeCount())
+        {
+            uint8 XDATA * heldPacket = radioLinkRxPacket[rxIndexPlus(offset)];
+            uint8 i;
+            for (i = 0; i < sizeof(radioLinkRxPacket[0]); i++)
+            {
+                heldPacket[i] = packet[i];
+            }
+            rxPreparePacket(heldPacket);
+            rxHeldMask |= 1 << (offset - 1);
+        }
+    }
+
+    // Otherwise it is a retransmission of a packet we already have, so it just gets ACKed.
+}
+
+void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
+{
+    uint8 waitedForBurst = rxWaitingForBurst;
+    rxWaitingForBurst = 0;
+
+    if (event == RADIO_MAC_EVENT_STROBE)
+    {
+        takeInitiative();
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_TX)
+    {
+        adaptTxDone();
+
+        if (txBurstMore)
+        {
+            // Keep sending the burst without waiting for an acknowledgment.
+            uint8 offset = txNextUnacked(txBurstOffset + 1);
+            if (offset < txSendLimit())
+            {
+                txDataPacket(offset);
+                return;
+            }
+        }
+
+        // We sent a packet, so now lets give the other party a chance to talk.
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], randomTxDelay());
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_RX)
+    {
+        uint8 XDATA * currentRxPacket = radioLinkRxPacket[radioLinkRxInterruptIndex];
+
+        if (!radioCrcPassed())
+        {
+            adaptRecord(0);
+            if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex || rxAckPending)
+            {
+                radioMacRx(currentRxPacket, randomTxDelay());
+            }
+            else
+            {
+                radioMacRx(currentRxPacket, 0);
+            }
+            return;
+        }
+
+        adaptRxPacket(currentRxPacket);
+
+        if ((currentRxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] & PACKET_TYPE_MASK) == PACKET_TYPE_RESET)
+        {
+            // The other Wixel sent a Reset packet, which means the next packet it sends will have a sequence number of 0.
+            rxExpectedSeq = 0;
+            rxHeldMask = 0;
+            acceptAnySequenceBit = 0;
+
+            // Notify the higher-level code.
+            radioLinkResetPacketReceived = 1;
+
+            // Send an ACK
+            txShortPacket(PACKET_TYPE_ACK);
+
+            radioLinkActivityOccurred = 1;
+
+            return;
+        }
+
+        if (currentRxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] < RADIO_LINK_PACKET_HEADER_LENGTH)
+        {
+            // Malformed packet; ignore it.
+            takeInitiative();
+            return;
+        }
+
+        if ((currentRxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] & PACKET_TYPE_MASK) != PACKET_TYPE_PING)
+        {
+            // The packet we received contains acknowledgments.
+
+            if (sendingReset)
+            {
+                // If we were sending a Reset packet, stop trying to resend it.
+                sendingReset = 0;
+
+                // Reset the transmission counter.
+                rttBackoff = 0;
+                radioLinkTxCurrentPacketTries = 0;
+
+                // Make sure the next packet we transmit has a sequence number of 0.
+                txBaseSeq = 0;
+                txAckedMask = 0;
+            }
+            else
+            {
+                rxProcessAck(currentRxPacket);
+            }
+        }
+
+        // Every packet tells us how many data packets the other party can accept.
+        txCredits = (currentRxPacket[RADIO_LINK_PACKET_ACK_OFFSET] & RADIO_LINK_ACK_CREDIT_MASK) >> RADIO_LINK_ACK_CREDIT_BIT_OFFSET;
+
+        if (currentRxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] > RADIO_LINK_PACKET_HEADER_LENGTH)
+        {
+            // We received a packet that contains actual data.
+            uint8 more = (currentRxPacket[RADIO_LINK_PACKET_ACK_OFFSET] & RADIO_LINK_ACK_MORE) ? 1 : 0;
+
+            rxDataPacket(currentRxPacket);
+            rxAckPending = 1;
+            radioLinkActivityOccurred = 1;
+
+            if (more)
+            {
+                // The other party is in the middle of a burst, so stay quiet and keep listening.
+                // If the rest of the burst is lost, the timeout will make us send our ACK.
+                rxWaitingForBurst = 1;
+                radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], 2);
+                return;
+            }
+        }
+
+        // Send our data (with the ACK) or the ACK by itself, or go back to listening.
+        takeInitiative();
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_RX_TIMEOUT)
+    {
+        if (txCredits == 0)
+        {
+            // We have waited long enough for a window update, so probe the other party
+            // with a data packet.  Its response will tell us how much credit it has.
+            txCredits = 1;
+        }
+        else if (!waitedForBurst && (sendingReset || radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex))
+        {
+            // We did not get an ACK in time, so wait longer before the next retry.
+            // (If we were waiting for the rest of the other party's burst instead,
+            // nothing we sent was lost.)
+            rttTimeoutExpired();
+            adaptTxFailed();
+        }
+        takeInitiative();
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_TX_BUSY)
+    {
+        // The channel is busy, so listen for a while and try again later.
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], randomTxDelay());
+        return;
+    }
+}
+
+#else
+
+static void txResetPacket()
+{
+    shortTxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] = 1;
+    shortTxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] = PACKET_TYPE_RESET;
+    radioMacTx(shortTxPacket);
+    if (radioLinkTxCurrentPacketTries < 255)
+    {
+        radioLinkTxCurrentPacketTries++;
+    }
+}
+
+// Returns the flag that tells the other party whether we can accept another data packet.
+static uint8 rxCreditFlag()
+{
+    uint8 nextradioLinkRxInterruptIndex = (radioLinkRxInterruptIndex == RX_PACKET_COUNT - 1) ? 0 : radioLinkRxInterruptIndex + 1;
+    rxWindowClosed = (nextradioLinkRxInterruptIndex == radioLinkRxMainLoopIndex);
+    return rxWindowClosed ? PACKET_FLAG_RX_FULL : 0;
+}
+
+// Sends an ACK or NAK with no data.
+static void txShortPacket(uint8 packetType)
+{
+    shortTxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] = RADIO_LINK_PACKET_HEADER_LENGTH;
+    shortTxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] = packetType | rxCreditFlag();
+    adaptFillHeader(shortTxPacket);
+    radioMacTx(shortTxPacket);
+}
+
 static void txDataPacket(uint8 packetType)
 {
     radioLinkTxPacket[radioLinkTxInterruptIndex][RADIO_LINK_PACKET_TYPE_OFFSET] =
-            (radioLinkTxPacket[radioLinkTxInterruptIndex][RADIO_LINK_PACKET_TYPE_OFFSET] & RADIO_LINK_PAYLOAD_TYPE_MASK) | packetType | txSequenceBit;
+            (radioLinkTxPacket[radioLinkTxInterruptIndex][RADIO_LINK_PACKET_TYPE_OFFSET] & RADIO_LINK_PAYLOAD_TYPE_MASK) | packetType | rxCreditFlag() | txSequenceBit;
+    adaptFillHeader(radioLinkTxPacket[radioLinkTxInterruptIndex]);
     radioMacTx(radioLinkTxPacket[radioLinkTxInterruptIndex]);
+    rttPacketSent();
     if (radioLinkTxCurrentPacketTries < 255)
     {
         radioLinkTxCurrentPacketTries++;
@@ -247,12 +1243,24 @@ static void takeInitiative()
         txResetPacket();
         radioLinkActivityOccurred = 1;
     }
-    else if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex)
+    else if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex && txCredits)
     {
         // Try to send the next data packet.
         txDataPacket(PACKET_TYPE_PING);
         radioLinkActivityOccurred = 1;
     }
+    else if (rxWindowClosed && !rxCreditFlag())
+    {
+        // The main loop freed an RX buffer after we told the other party we had no room.
+        // Send a window update.  It is a NAK so that it does not acknowledge anything.
+        txShortPacket(PACKET_TYPE_NAK);
+    }
+    else if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex)
+    {
+        // We have data but the other party has no room for it.  Wait for it to advertise
+        // credit, but not forever in case its window update gets lost.
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], RADIO_LINK_PERSIST_TIMEOUT);
+    }
     else
     {
         radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], 0);
@@ -268,6 +1276,8 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
     }
     else if (event == RADIO_MAC_EVENT_TX)
     {
+        adaptTxDone();
+
         // We sent a packet, so now lets give the other party a chance to talk.
         radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], randomTxDelay());
         return;
@@ -278,6 +1288,7 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
 
         if (!radioCrcPassed())
         {
+            adaptRecord(0);
             if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex)
             {
                 radioMacRx(currentRxPacket, randomTxDelay());
@@ -289,6 +1300,8 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
             return;
         }
 
+        adaptRxPacket(currentRxPacket);
+
         if ((currentRxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] & PACKET_TYPE_MASK) == PACKET_TYPE_RESET)
         {
             // The other Wixel sent a Reset packet, which means the next packet it sends will have a sequence bit of 0.
@@ -299,15 +1312,16 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
             radioLinkResetPacketReceived = 1;
 
             // Send an ACK
-            shortTxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] = 1;
-            shortTxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] = PACKET_TYPE_ACK;
-            radioMacTx(shortTxPacket);
+            txShortPacket(PACKET_TYPE_ACK);
 
             radioLinkActivityOccurred = 1;
 
             return;
         }
 
+        // Every packet tells us whether the other party can accept a data packet.
+        txCredits = (currentRxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] & PACKET_FLAG_RX_FULL) ? 0 : 1;
+
         if ((currentRxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] & PACKET_TYPE_MASK) == PACKET_TYPE_ACK)
         {
             // The packet we received contained an acknowledgment.
@@ -318,6 +1332,7 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
                 sendingReset = 0;
 
                 // Reset the transmission counter.
+                rttBackoff = 0;
                 radioLinkTxCurrentPacketTries = 0;
 
                 // Make sure the next packet we transmit has a sequence bit of 0.
@@ -340,6 +1355,7 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
                 }
 
                 // Reset the transmission counter.
+                rttPacketAcked();
                 radioLinkTxCurrentPacketTries = 0;
 
                 // The next packet we transmit will have a different sequence bit.
@@ -403,36 +1419,52 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
 
             // Send an ACK or NAK to the other party.
 
-            if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex)
+            if (radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex && txCredits)
             {
                 // Send some data along with the ACK or NAK.
                 txDataPacket(responsePacketType);
             }
             else
             {
-                // No data is available, so just send the ACK or NAK by itself.
-
-                shortTxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] = 1;
-                shortTxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] = responsePacketType;
-                radioMacTx(shortTxPacket);
+                // No data is available (or the other party has no room for it),
+                // so just send the ACK or NAK by itself.
+                txShortPacket(responsePacketType);
             }
 
             radioLinkActivityOccurred = 1;
         }
         else
         {
-            // TODO: if radioLinkTxCurrentPacketTries > 200 then we should probably just go
-            // into RX mode here so we can avoid having this conversation 4 times per second:
-            // DATA, NAK, DATA, NAK, DATA, NAK, DATA, NAK, DATA, NAK, ...
-            // (It starts when the sender takes initiative and sends his (failing) data every
-            // 250ms, and it ends as soon as one packet is lost.)
+            // This packet had no data.  If it was a NAK telling us the other party has no
+            // room, txCredits is now 0 and takeInitiative() will wait for a window update
+            // instead of starting a DATA, NAK, DATA, NAK, ... conversation.
             takeInitiative();
         }
         return;
     }
     else if (event == RADIO_MAC_EVENT_RX_TIMEOUT)
     {
+        if (txCredits == 0)
+        {
+            // We have waited long enough for a window update, so probe the other party
+            // with a data packet.  Its response will tell us how much credit it has.
+            txCredits = 1;
+        }
+        else if (sendingReset || radioLinkTxInterruptIndex != radioLinkTxMainLoopIndex)
+        {
+            // We did not get an ACK in time, so wait longer before the next retry.
+            rttTimeoutExpired();
+            adaptTxFailed();
+        }
         takeInitiative();
         return;
     }
+    else if (event == RADIO_MAC_EVENT_TX_BUSY)
+    {
+        // The channel is busy, so listen for a while and try again later.
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], randomTxDelay());
+        return;
+    }
 }
+
+#endif
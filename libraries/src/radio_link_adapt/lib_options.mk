@@ -0,0 +1,15 @@
+# This library is the link adaptation build of radio_link.
+# Apps select it by listing radio_link_adapt.lib instead of radio_link.lib
+# in their APP_LIBS.
+LIB_RELS := libraries/src/radio_link_adapt/radio_link_adapt.rel
+
+# When the rel (object) file is compiled, there will be a special
+# preprocessor flag to enable the link adaptation byte in the header.
+libraries/src/radio_link_adapt/radio_link_adapt.rel : C_FLAGS += -DRADIO_LINK_ADAPT
+
+# The rel file will be compiled from radio_link_adapt.c,
+# which will be a copy of radio_link/radio_link.c.
+libraries/src/radio_link_adapt/radio_link_adapt.c : libraries/src/radio_link/radio_link.c
+	$(CP) $< $@
+
+TARGETS += libraries/src/radio_link_adapt/radio_link_adapt.c
@@ -0,0 +1,588 @@
+/* radio_link_multi.c:
+ *  This layer uses radio_mac.c in order to provide reliable ordered delivery and reception of
+ *  a series of data packets between this device and several others.  It works the same way as
+ *  radio_link.c (stop-and-wait with a sequence bit, and Ping/ACK/NAK/Reset packets), but each
+ *  packet carries a destination and source address after the link header byte, and all of the
+ *  sequencing state that radio_link.c keeps in single bits is kept per peer instead.
+ *  The destination address comes first so that the radio's hardware address filter can discard
+ *  packets meant for other devices before they cost us an interrupt.
+ *
+ *  Each peer has its own small TX queue.  When we take the initiative to send something, we
+ *  serve the peers round-robin, so one peer with a lot of queued data does not starve the others.
+ *  Since each exchange is stop-and-wait with one peer and every packet says who it is from,
+ *  exchanges with different peers can be interleaved freely.
+ */
+
+#include <radio_link_multi.h>
+#include <radio_registers.h>
+#include <random.h>
+
+/* PARAMETERS *****************************************************************/
+
+int32 CODE param_radio_channel = 128;
+int32 CODE param_radio_address = 0;
+
+/* PACKET VARIABLES AND DEFINES ***********************************************/
+
+// The link layer will add a three byte header to the beginning of each packet:
+// the destination address, the same type byte as radio_link.c, and the source address.
+#define RADIO_LINK_PACKET_HEADER_LENGTH 3
+
+// Compute the max size of on-the-air packets.  This value is stored in the PKTLEN register.
+#define RADIO_MAX_PACKET_SIZE  (RADIO_LINK_MULTI_PAYLOAD_SIZE + RADIO_LINK_PACKET_HEADER_LENGTH)
+
+#define RADIO_LINK_PACKET_LENGTH_OFFSET 0
+#define RADIO_LINK_PACKET_DEST_OFFSET   1   // Must be first so the radio's address filter can check it.
+#define RADIO_LINK_PACKET_TYPE_OFFSET   2
+#define RADIO_LINK_PACKET_SRC_OFFSET    3
+
+#define RADIO_LINK_PAYLOAD_TYPE_BIT_OFFSET 1
+#define RADIO_LINK_PAYLOAD_TYPE_MASK       0b00011110
+
+#define PACKET_TYPE_MASK  (3 << 6) // These are the bits that determine the packet type.
+#define PACKET_TYPE_PING  (0 << 6) // If both bits are zero, it is just a Ping packet (with optional data).
+#define PACKET_TYPE_NAK   (1 << 6) // A NAK packet (with optional data)
+#define PACKET_TYPE_ACK   (2 << 6) // An ACK packet (with optional data)
+#define PACKET_TYPE_RESET (3 << 6) // A Reset packet (the next packet transmitted by the sender of this packet will have a sequence number of 0)
+
+// Set when the sender of this packet has no RX buffer for another data packet (see radio_link.c).
+#define PACKET_FLAG_RX_FULL  (1 << 5)
+
+// How long to wait, in units of 0.922 ms, for a peer to advertise credit before
+// we send it a data packet anyway.
+#define RADIO_LINK_PERSIST_TIMEOUT 250
+
+/*  rxPackets:
+ *  These are shared by all peers and work the same way as in radio_link.c.
+ *  After a packet is given to the main loop, the byte that held the link header
+ *  holds the source address instead.
+ */
+#define RX_PACKET_COUNT  3
+static volatile uint8 XDATA radioLinkRxPacket[RX_PACKET_COUNT][1 + RADIO_MAX_PACKET_SIZE + 2];
+static volatile uint8 DATA radioLinkRxMainLoopIndex = 0;   // The index of the next rxBuffer to read from the main loop.
+static volatile uint8 DATA radioLinkRxInterruptIndex = 0;  // The index of the next rxBuffer to write to when a packet comes from the radio.
+
+#define RADIO_LINK_RX_ADDRESS_OFFSET RADIO_LINK_PACKET_TYPE_OFFSET
+
+/*  txPackets:
+ *  Each peer has its own queue, handled the same way as the single queue in radio_link.c.
+ *  Together they take the same amount of memory as radio_link.c's 16-packet queue.
+ */
+#define TX_PACKET_COUNT 4   // Per peer.  Must be a power of 2.
+static volatile uint8 XDATA radioLinkTxPacket[RADIO_LINK_MULTI_MAX_PEERS][TX_PACKET_COUNT][1 + RADIO_MAX_PACKET_SIZE];
+static volatile uint8 radioLinkTxMainLoopIndex[RADIO_LINK_MULTI_MAX_PEERS];   // The index of the next txPacket to write to in the main loop.
+static volatile uint8 radioLinkTxInterruptIndex[RADIO_LINK_MULTI_MAX_PEERS];  // The index of the current txPacket we are trying to send on the radio.
+
+static uint8 XDATA shortTxPacket[1 + RADIO_LINK_PACKET_HEADER_LENGTH];
+
+volatile BIT radioLinkMultiResetPacketReceived;
+volatile uint8 radioLinkMultiResetPacketAddress;
+
+/* PEER VARIABLES *************************************************************/
+
+// The addresses of the peers in the table.  Entries 0 to peerCount-1 are used.
+static volatile uint8 peerAddress[RADIO_LINK_MULTI_MAX_PEERS];
+static volatile uint8 DATA peerCount = 0;
+
+// Per-peer versions of the bits that radio_link.c keeps for its single peer.
+#define PEER_FLAG_RX_SEQUENCE_BIT    (1 << 0)  // Sequence bit of the LAST packet received from the peer.
+#define PEER_FLAG_TX_SEQUENCE_BIT    (1 << 1)  // Sequence bit of the NEXT packet we will send to the peer.
+#define PEER_FLAG_ACCEPT_ANY         (1 << 2)  // Accept any sequence bit from the peer.
+#define PEER_FLAG_SENDING_RESET      (1 << 3)  // We are trying to send a Reset packet to the peer.
+#define PEER_FLAG_NO_CREDIT          (1 << 4)  // The peer told us it has no room for data.
+#define PEER_FLAG_TOLD_FULL          (1 << 5)  // We told the peer we have no room for data.
+static volatile uint8 peerFlags[RADIO_LINK_MULTI_MAX_PEERS];
+
+// The number of times the current TX packet for each peer has been transmitted.
+// Does NOT overflow.
+static uint8 peerTxTries[RADIO_LINK_MULTI_MAX_PEERS];
+
+// The peer we most recently took the initiative with.  Used for round-robin scheduling.
+static uint8 DATA lastPeer = 0;
+
+// The peer we most recently transmitted to.
+static uint8 DATA currentPeer = 0;
+
+// 1 if we are listening because every peer we have data for has no room for it.
+static volatile BIT waitingForCredit = 0;
+
+/* GENERAL VARIABLES **********************************************************/
+
+volatile BIT radioLinkMultiActivityOccurred;
+
+/* GENERAL FUNCTIONS **********************************************************/
+
+void radioLinkMultiInit()
+{
+    randomSeedFromSerialNumber();
+
+    PKTLEN = RADIO_MAX_PACKET_SIZE;
+    CHANNR = param_radio_channel;
+
+    radioMacInit();
+    radioMacAddressFilter(param_radio_address, RADIO_MAC_ADDRESS_CHECK_NO_BROADCAST);
+    radioMacStrobe();
+}
+
+// Returns a random delay in units of 0.922 ms (the same units of radioMacRx).
+// This is used to decide how long to wait before retransmitting to the given peer.
+// See randomTxDelay() in radio_link.c.
+static uint8 randomTxDelay(uint8 peer)
+{
+    return (peerTxTries[peer] > 200 ? 250 : 1) + (randomNumber() & 3);
+}
+
+// Returns the index of the peer with the given address, or 0xFF if it is not in the table.
+static uint8 findPeer(uint8 address)
+{
+    uint8 peer;
+    for (peer = 0; peer < peerCount; peer++)
+    {
+        if (peerAddress[peer] == address)
+        {
+            return peer;
+        }
+    }
+    return 0xFF;
+}
+
+// Returns the index of the peer with the given address, adding it to the table if
+// necessary.  Returns 0xFF if the table is full.
+// A new peer gets a Reset packet so that it knows our sequence bit, just like
+// radio_link.c does at startup.
+static uint8 addPeer(uint8 address)
+{
+    uint8 peer = findPeer(address);
+    if (peer == 0xFF && peerCount < RADIO_LINK_MULTI_MAX_PEERS)
+    {
+        peer = peerCount;
+        peerAddress[peer] = address;
+        peerFlags[peer] = PEER_FLAG_RX_SEQUENCE_BIT | PEER_FLAG_ACCEPT_ANY | PEER_FLAG_SENDING_RESET;
+        peerTxTries[peer] = 0;
+        radioLinkTxMainLoopIndex[peer] = 0;
+        radioLinkTxInterruptIndex[peer] = 0;
+        peerCount = peer + 1;
+    }
+    return peer;
+}
+
+// Like addPeer, but safe to call from the main loop.
+static uint8 addPeerFromMainLoop(uint8 address)
+{
+    uint8 peer = findPeer(address);
+    if (peer == 0xFF)
+    {
+        // The ISR can also add peers, so keep it from running while we do.
+        uint8 rfInterruptEnabled = IEN2 & 0x01;
+        IEN2 &= ~0x01;    // Disable RF general interrupt
+        peer = addPeer(address);
+        if (rfInterruptEnabled)
+        {
+            IEN2 |= 0x01;    // Enable RF general interrupt
+        }
+        radioMacStrobe();
+    }
+    return peer;
+}
+
+static BIT peerTxPending(uint8 peer)
+{
+    return radioLinkTxInterruptIndex[peer] != radioLinkTxMainLoopIndex[peer];
+}
+
+/* TX FUNCTIONS (called by higher-level code in main loop) ********************/
+
+uint8 radioLinkMultiTxAvailable(uint8 address)
+{
+    uint8 peer = addPeerFromMainLoop(address);
+    if (peer == 0xFF)
+    {
+        return 0;
+    }
+
+    // Assumption: TX_PACKET_COUNT is a power of 2
+    return (radioLinkTxInterruptIndex[peer] - radioLinkTxMainLoopIndex[peer] - 1) & (TX_PACKET_COUNT - 1);
+}
+
+uint8 radioLinkMultiTxQueued(uint8 address)
+{
+    uint8 peer = findPeer(address);
+    if (peer == 0xFF)
+    {
+        return 0;
+    }
+
+    return (radioLinkTxMainLoopIndex[peer] - radioLinkTxInterruptIndex[peer]) & (TX_PACKET_COUNT - 1);
+}
+
+uint8 XDATA * radioLinkMultiTxCurrentPacket(uint8 address)
+{
+    uint8 peer;
+
+    if (!radioLinkMultiTxAvailable(address))
+    {
+        return 0;
+    }
+
+    peer = findPeer(address);
+    return radioLinkTxPacket[peer][radioLinkTxMainLoopIndex[peer]] + RADIO_LINK_PACKET_HEADER_LENGTH;
+}
+
+void radioLinkMultiTxSendPacket(uint8 address, uint8 payloadType)
+{
+    uint8 peer = findPeer(address);
+    uint8 XDATA * packet = radioLinkTxPacket[peer][radioLinkTxMainLoopIndex[peer]];
+
+    // Now we set the length byte.
+    packet[0] = packet[RADIO_LINK_PACKET_HEADER_LENGTH] + RADIO_LINK_PACKET_HEADER_LENGTH;
+
+    // Put the payloadType and addresses into the packet header.
+    packet[RADIO_LINK_PACKET_TYPE_OFFSET] = payloadType << RADIO_LINK_PAYLOAD_TYPE_BIT_OFFSET;
+    packet[RADIO_LINK_PACKET_DEST_OFFSET] = address;
+    packet[RADIO_LINK_PACKET_SRC_OFFSET] = param_radio_address;
+
+    // Update our index of which packet to populate in the main loop.
+    radioLinkTxMainLoopIndex[peer] = (radioLinkTxMainLoopIndex[peer] + 1) & (TX_PACKET_COUNT - 1);
+
+    // Make sure that radioMacEventHandler runs soon so it can see this new data and send it.
+    // This must be done LAST.
+    radioMacStrobe();
+}
+
+/* RX FUNCTIONS (called by higher-level code in main loop) ********************/
+
+uint8 XDATA * radioLinkMultiRxCurrentPacket(void)
+{
+    if (radioLinkRxMainLoopIndex == radioLinkRxInterruptIndex)
+    {
+        return 0;
+    }
+
+    return radioLinkRxPacket[radioLinkRxMainLoopIndex] + RADIO_LINK_PACKET_HEADER_LENGTH;
+}
+
+uint8 radioLinkMultiRxCurrentPayloadType(void)
+{
+    return radioLinkRxPacket[radioLinkRxMainLoopIndex][0];
+}
+
+uint8 radioLinkMultiRxCurrentAddress(void)
+{
+    return radioLinkRxPacket[radioLinkRxMainLoopIndex][RADIO_LINK_RX_ADDRESS_OFFSET];
+}
+
+void radioLinkMultiRxDoneWithPacket(void)
+{
+    uint8 peer;
+
+    if (radioLinkRxMainLoopIndex == RX_PACKET_COUNT - 1)
+    {
+        radioLinkRxMainLoopIndex = 0;
+    }
+    else
+    {
+        radioLinkRxMainLoopIndex++;
+    }
+
+    for (peer = 0; peer < peerCount; peer++)
+    {
+        if (peerFlags[peer] & PEER_FLAG_TOLD_FULL)
+        {
+            // We told this peer we had no room, so make sure the ISR runs soon
+            // and tells it that there is room now.
+            radioMacStrobe();
+            break;
+        }
+    }
+}
+
+/* FUNCTIONS CALLED IN RF_ISR *************************************************/
+
+// Returns the flag that tells the given peer whether we can accept another data packet.
+static uint8 rxCreditFlag(uint8 peer)
+{
+    uint8 nextradioLinkRxInterruptIndex = (radioLinkRxInterruptIndex == RX_PACKET_COUNT - 1) ? 0 : radioLinkRxInterruptIndex + 1;
+    if (nextradioLinkRxInterruptIndex == radioLinkRxMainLoopIndex)
+    {
+        peerFlags[peer] |= PEER_FLAG_TOLD_FULL;
+        return PACKET_FLAG_RX_FULL;
+    }
+    peerFlags[peer] &= ~PEER_FLAG_TOLD_FULL;
+    return 0;
+}
+
+// Sends a packet with no data to the given peer.
+static void txShortPacket(uint8 peer, uint8 packetType)
+{
+    shortTxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] = RADIO_LINK_PACKET_HEADER_LENGTH;
+    shortTxPacket[RADIO_LINK_PACKET_TYPE_OFFSET] = packetType == PACKET_TYPE_RESET ? PACKET_TYPE_RESET : (packetType | rxCreditFlag(peer));
+    shortTxPacket[RADIO_LINK_PACKET_DEST_OFFSET] = peerAddress[peer];
+    shortTxPacket[RADIO_LINK_PACKET_SRC_OFFSET] = param_radio_address;
+    currentPeer = peer;
+    radioMacTx(shortTxPacket);
+}
+
+static void txResetPacket(uint8 peer)
+{
+    txShortPacket(peer, PACKET_TYPE_RESET);
+    if (peerTxTries[peer] < 255)
+    {
+        peerTxTries[peer]++;
+    }
+}
+
+static void txDataPacket(uint8 peer, uint8 packetType)
+{
+    uint8 XDATA * packet = radioLinkTxPacket[peer][radioLinkTxInterruptIndex[peer]];
+
+    packet[RADIO_LINK_PACKET_TYPE_OFFSET] = (packet[RADIO_LINK_PACKET_TYPE_OFFSET] & RADIO_LINK_PAYLOAD_TYPE_MASK) |
+        packetType | rxCreditFlag(peer) | ((peerFlags[peer] & PEER_FLAG_TX_SEQUENCE_BIT) ? 1 : 0);
+    currentPeer = peer;
+    radioMacTx(packet);
+    if (peerTxTries[peer] < 255)
+    {
+        peerTxTries[peer]++;
+    }
+}
+
+static void takeInitiative()
+{
+    uint8 i;
+    uint8 peer = lastPeer;
+
+    waitingForCredit = 0;
+
+    // Serve the peers round-robin, starting after the one we served last.
+    for (i = 0; i < peerCount; i++)
+    {
+        peer++;
+        if (peer >= peerCount)
+        {
+            peer = 0;
+        }
+
+        if (peerFlags[peer] & PEER_FLAG_SENDING_RESET)
+        {
+            // Try to send a reset packet.
+            lastPeer = peer;
+            txResetPacket(peer);
+            radioLinkMultiActivityOccurred = 1;
+            return;
+        }
+
+        if (peerTxPending(peer))
+        {
+            if (!(peerFlags[peer] & PEER_FLAG_NO_CREDIT))
+            {
+                // Try to send the next data packet.
+                lastPeer = peer;
+                txDataPacket(peer, PACKET_TYPE_PING);
+                radioLinkMultiActivityOccurred = 1;
+                return;
+            }
+            waitingForCredit = 1;
+        }
+
+        if ((peerFlags[peer] & PEER_FLAG_TOLD_FULL) && !rxCreditFlag(peer))
+        {
+            // The main loop freed an RX buffer after we told this peer we had no room.
+            // Send a window update.  It is a NAK so that it does not acknowledge anything.
+            lastPeer = peer;
+            txShortPacket(peer, PACKET_TYPE_NAK);
+            return;
+        }
+    }
+
+    // Nothing to send right now.  If a peer has no room for our data, do not wait
+    // forever in case its window update gets lost.
+    radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], waitingForCredit ? RADIO_LINK_PERSIST_TIMEOUT : 0);
+}
+
+// Keeps listening after a packet that we could not use.
+static void rxIgnorePacket(uint8 XDATA * currentRxPacket)
+{
+    if (peerTxPending(currentPeer))
+    {
+        // We are probably waiting for an ACK from the current peer.
+        radioMacRx(currentRxPacket, randomTxDelay(currentPeer));
+    }
+    else
+    {
+        takeInitiative();
+    }
+}
+
+void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
+{
+    if (event == RADIO_MAC_EVENT_STROBE)
+    {
+        takeInitiative();
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_TX)
+    {
+        // We sent a packet, so now lets give the peer a chance to talk.
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], randomTxDelay(currentPeer));
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_RX)
+    {
+        uint8 XDATA * currentRxPacket = radioLinkRxPacket[radioLinkRxInterruptIndex];
+        uint8 type;
+        uint8 peer;
+
+        if (!radioCrcPassed() || currentRxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] < RADIO_LINK_PACKET_HEADER_LENGTH ||
+            currentRxPacket[RADIO_LINK_PACKET_DEST_OFFSET] != (uint8)param_radio_address)
+        {
+            // The packet is corrupt or it is for someone else.
+            rxIgnorePacket(currentRxPacket);
+            return;
+        }
+
+        peer = addPeer(currentRxPacket[RADIO_LINK_PACKET_SRC_OFFSET]);
+        if (peer == 0xFF)
+        {
+            // The peer table is full, so we can not talk to this peer.
+            rxIgnorePacket(currentRxPacket);
+            return;
+        }
+
+        type = currentRxPacket[RADIO_LINK_PACKET_TYPE_OFFSET];
+
+        if ((type & PACKET_TYPE_MASK) == PACKET_TYPE_RESET)
+        {
+            // The peer sent a Reset packet, which means the next packet it sends will have a sequence bit of 0.
+            // So we should set its "previously received" sequence bit to 1 so we expect a 0 next.
+            peerFlags[peer] |= PEER_FLAG_RX_SEQUENCE_BIT;
+
+            // Notify the higher-level code.
+            radioLinkMultiResetPacketAddress = peerAddress[peer];
+            radioLinkMultiResetPacketReceived = 1;
+
+            // Send an ACK
+            txShortPacket(peer, PACKET_TYPE_ACK);
+
+            radioLinkMultiActivityOccurred = 1;
+
+            return;
+        }
+
+        // Every packet tells us whether the peer can accept a data packet.
+        if (type & PACKET_FLAG_RX_FULL)
+        {
+            peerFlags[peer] |= PEER_FLAG_NO_CREDIT;
+        }
+        else
+        {
+            peerFlags[peer] &= ~PEER_FLAG_NO_CREDIT;
+        }
+
+        if ((type & PACKET_TYPE_MASK) == PACKET_TYPE_ACK)
+        {
+            // The packet we received contained an acknowledgment.
+
+            if (peerFlags[peer] & PEER_FLAG_SENDING_RESET)
+            {
+                // If we were sending a Reset packet, stop trying to resend it,
+                // and make sure the next packet we transmit has a sequence bit of 0.
+                peerFlags[peer] &= ~(PEER_FLAG_SENDING_RESET | PEER_FLAG_TX_SEQUENCE_BIT);
+                peerTxTries[peer] = 0;
+            }
+            else if (peerTxPending(peer))
+            {
+                // Give ownership of the current TX packet back to the main loop.
+                radioLinkTxInterruptIndex[peer] = (radioLinkTxInterruptIndex[peer] + 1) & (TX_PACKET_COUNT - 1);
+
+                // Reset the transmission counter.
+                peerTxTries[peer] = 0;
+
+                // The next packet we transmit will have a different sequence bit.
+                peerFlags[peer] ^= PEER_FLAG_TX_SEQUENCE_BIT;
+            }
+        }
+
+        if (currentRxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] > RADIO_LINK_PACKET_HEADER_LENGTH)
+        {
+            // We received a packet that contains actual data.
+
+            uint8 responsePacketType = PACKET_TYPE_ACK;
+
+            if ((peerFlags[peer] & PEER_FLAG_ACCEPT_ANY) ||
+                ((peerFlags[peer] & PEER_FLAG_RX_SEQUENCE_BIT) ? 1 : 0) != (type & 1))
+            {
+                // This packet is NOT a retransmission of the last packet we received from this peer.
+
+                uint8 nextradioLinkRxInterruptIndex = (radioLinkRxInterruptIndex == RX_PACKET_COUNT - 1) ? 0 : radioLinkRxInterruptIndex + 1;
+
+                if (nextradioLinkRxInterruptIndex != radioLinkRxMainLoopIndex)
+                {
+                    // We can accept this packet and send an ACK!
+
+                    // Set the peer's sequence bit to match the sequence bit in the received packet.
+                    peerFlags[peer] = (peerFlags[peer] & ~(PEER_FLAG_RX_SEQUENCE_BIT | PEER_FLAG_ACCEPT_ANY)) |
+                        ((type & 1) ? PEER_FLAG_RX_SEQUENCE_BIT : 0);
+
+                    // Set length byte that will be read by the higher-level code.
+                    // (This overrides the source address.)
+                    currentRxPacket[RADIO_LINK_PACKET_HEADER_LENGTH] = currentRxPacket[RADIO_LINK_PACKET_LENGTH_OFFSET] - RADIO_LINK_PACKET_HEADER_LENGTH;
+
+                    // Set the source address which will be read by radioLinkMultiRxCurrentAddress().
+                    // (This overrides the link header.)
+                    currentRxPacket[RADIO_LINK_RX_ADDRESS_OFFSET] = peerAddress[peer];
+
+                    // Set the payload type byte which will be read by radioLinkMultiRxCurrentPayloadType().
+                    // (This overrides the RF packet length.)
+                    currentRxPacket[0] = (type & RADIO_LINK_PAYLOAD_TYPE_MASK) >> RADIO_LINK_PAYLOAD_TYPE_BIT_OFFSET;
+
+                    radioLinkRxInterruptIndex = nextradioLinkRxInterruptIndex;
+                }
+                else
+                {
+                    // The main loop is already using all of the other RX packet buffers,
+                    // so we can't give this packet to the main loop and we will send a NAK.
+                    responsePacketType = PACKET_TYPE_NAK;
+                }
+            }
+
+            // Send an ACK or NAK to the peer.
+            lastPeer = peer;
+            if (peerTxPending(peer) && !(peerFlags[peer] & (PEER_FLAG_NO_CREDIT | PEER_FLAG_SENDING_RESET)))
+            {
+                // Send some data along with the ACK or NAK.
+                txDataPacket(peer, responsePacketType);
+            }
+            else
+            {
+                txShortPacket(peer, responsePacketType);
+            }
+
+            radioLinkMultiActivityOccurred = 1;
+        }
+        else
+        {
+            takeInitiative();
+        }
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_RX_TIMEOUT)
+    {
+        if (waitingForCredit)
+        {
+            // We have waited long enough for a window update, so probe the peers
+            // with data packets.  Their responses will tell us if they have room.
+            uint8 peer;
+            for (peer = 0; peer < peerCount; peer++)
+            {
+                peerFlags[peer] &= ~PEER_FLAG_NO_CREDIT;
+            }
+        }
+        takeInitiative();
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_TX_BUSY)
+    {
+        // The channel is busy, so listen for a while and try again later.
+        radioMacRx(radioLinkRxPacket[radioLinkRxInterruptIndex], randomTxDelay(currentPeer));
+        return;
+    }
+}
@@ -0,0 +1,15 @@
+# This library is the windowed (selective-repeat) build of radio_link.
+# Apps select it by listing radio_link_window.lib instead of radio_link.lib
+# in their APP_LIBS.
+LIB_RELS := libraries/src/radio_link_window/radio_link_window.rel
+
+# When the rel (object) file is compiled, there will be a special
+# preprocessor flag to specify how many packets can be in flight.
+libraries/src/radio_link_window/radio_link_window.rel : C_FLAGS += -DRADIO_LINK_WINDOW_SIZE=4
+
+# The rel file will be compiled from radio_link_window.c,
+# which will be a copy of radio_link/radio_link.c.
+libraries/src/radio_link_window/radio_link_window.c : libraries/src/radio_link/radio_link.c
+	$(CP) $< $@
+
+TARGETS += libraries/src/radio_link_window/radio_link_window.c
@@ -1,17 +1,34 @@
 /*  NOTE: Calibration of the frequency synthesizer and other RF hardware takes about 800 us and
  *  must be done regularly.  There are several options for when to do the calibration and not.
- *  We configured the radio to automatically calibrate whenever going from the IDLE state to TX
- *  or RX (MCSM0.FS_AUTOCAL = 01).  The radio will go into the idle state whenever the is an RX
- *  timeout.  However, to enable a quick turnaround between TX and RX, we configured the radio to
- *  automatically go into the FSTXON mode after it is done with RX or TX mode.  FSTXON means that
- *  the frequency synthesizer is on and the radio is ready to go into RX or TX mode quickly
- *  (but it goes to TX mode faster).
+ *  To enable a quick turnaround between TX and RX, we configured the radio to automatically go
+ *  into the FSTXON mode after it is done with RX or TX mode.  FSTXON means that the frequency
+ *  synthesizer is on and the radio is ready to go into RX or TX mode quickly (but it goes to TX
+ *  mode faster).  The radio will go into the idle state whenever there is an RX timeout.
  *
- *  So basically we are depending on the RX timeout feature to schedule our calibrations for us,
- *  instead of doing it manually.  This should work, but it will probaby hinder our ability to
- *  quickly recover from lost packets (the RX timeout event is what happens when a packet is lost).
- *  An easy alternative would be to only calibrate after every 10th RX timeout or something like
- *  that.
+ *  By default, the radio calibrates automatically whenever going from the IDLE state to TX or
+ *  RX (MCSM0.FS_AUTOCAL = 01), which means that every RX timeout (which is what happens when a
+ *  packet is lost) costs an extra 800 us.  If the higher-level code sets
+ *  radioMacCalibrationScheduled, automatic calibration is disabled instead, and
+ *  radioMacCalibrateIfNeeded decides when to calibrate according to the policy set by the
+ *  higher-level code (every N events, every T ms, or when radioMacCalibrateSoon is called).
+ *  When it is time to calibrate, it puts the radio in IDLE and turns on FS_AUTOCAL for just that
+ *  one transition, so the radio does the calibration on its own without the CPU having to wait
+ *  for it in the ISR.  radioMacCalibrateSoon works in both modes, which matters for code that
+ *  turns FS_AUTOCAL off on its own (such as the channel cache in radio_registers).
+ */
+
+/*  Normally, every radio event goes through radioMacEvent, which stops the radio and the DMA,
+ *  calls the higher-level code, and then restarts the radio.  Packets that arrive during that
+ *  time are lost.  To avoid that, the higher-level code can call radioMacRxNext to set up the
+ *  DMA for the NEXT received packet ahead of time on the alternate radio DMA channel.  Then when
+ *  a packet is received, radioMacRxContinue re-arms the DMA and puts the radio back in RX
+ *  mode before calling the higher-level code.  The two radio DMA channels take turns.
+ */
+
+/*  radio_mac_trace.lib is a build of this file with RADIO_MAC_TRACE defined.  It records the time
+ *  of every radio interrupt that reports an event, how long it took to get from the start of the
+ *  ISR to radioMacEventHandler, and how long radioMacEventHandler took.  The times come from
+ *  Timer 4, which time.c uses to count milliseconds, so this does not use any extra hardware.
  */
 
 /*  The definition of the maximum packet size (and the code that sets the PKTLEN register) is not
@@ -25,6 +42,7 @@
 #include <cc2511_map.h>
 #include <dma.h>
 #include <radio_registers.h>
+#include <time.h>
 
 #include <random.h>
 
@@ -38,15 +56,66 @@
 #define STX     3
 #define SIDLE   4
 
+// The number of microseconds to wait after entering RX mode before reading the
+// CCA bit, so that the RSSI measurement is valid.
+#define CCA_SETTLE_TIME  40
+
+// The maximum number of microseconds to wait for the radio to get to RX mode before
+// checking the channel.  Going from IDLE to RX can include a calibration (about 800 us).
+#define CCA_RX_TIMEOUT   1200
+
+// MCSM1.CCA_MODE = 11: The CCA bit in PKTSTATUS means the RSSI is below the threshold
+// and no packet is being received.
+#define MCSM1_CCA_MODE_MASK  0x30
+
 static void radioMacEvent(uint8 event);
+static void radioMacRxContinue(void);
+static void radioMacRecoverFromOverflow(void);
+static void radioMacRxRestart(void);
+static uint8 radioMacRxAligned(void);
+static void radioMacCallHandler(uint8 event);
 
 // Bits for sending commands to the MAC in an interrupt safe way.
 static volatile BIT strobe = 0;
 static volatile BIT sleepRadioMac = 0;
 
+// Calibration policy
+BIT radioMacCalibrationScheduled = 0;
+uint8 radioMacCalibrationEventInterval = 0;
+uint16 radioMacCalibrationMsInterval = 1000;
+static volatile BIT calibrateSoon = 1;   // 1 iff we should calibrate the next time we start the radio.
+static BIT autoCalibrationOn = 0;        // 1 iff we set MCSM0.FS_AUTOCAL to 01 for one calibration.
+static uint8 DATA savedAutoCalibration;  // The MCSM0.FS_AUTOCAL bits to restore after that calibration.
+static uint8 DATA eventsSinceCalibration = 0;
+static uint16 lastCalibrationTime = 0;
+
 // Error reporting
 volatile BIT radioRxOverflowOccurred = 0;
 volatile BIT radioTxUnderflowOccurred = 0;
+volatile uint8 radioMacRxOverflowCount = 0;
+volatile uint8 radioMacTxUnderflowCount = 0;
+volatile uint8 radioMacCrcErrorCount = 0;
+volatile uint8 radioMacRxTimeoutCount = 0;
+volatile uint8 radioMacChannelBusyCount = 0;
+
+// Listen before talk
+BIT radioMacListenBeforeTalk = 0;
+
+// 1 iff hardware address filtering is enabled (see radioMacAddressFilter).
+static BIT addressFilterOn = 0;
+
+// The radio does not interrupt us when the address filter rejects a packet, so a strobe
+// that was deferred while that packet was being received would wait for the next packet.
+// When address filtering is on, we never listen with an infinite RX timeout; we use this
+// timeout (in ms) instead, and when it expires we handle the strobe or keep listening.
+#define ADDRESS_FILTER_RX_TIMEOUT  50
+
+// 1 iff the current RX timeout is ADDRESS_FILTER_RX_TIMEOUT, which the higher-level
+// code did not ask for.
+static volatile BIT rxTimeoutHidden = 0;
+
+// Increments one of the error counters above, unless it is already at its maximum value.
+#define INCREMENT_ERROR_COUNT(count)  if ((count) != 255){ (count)++; }
 
 // Radio MAC states
 #define RADIO_MAC_STATE_OFF      0
@@ -57,8 +126,104 @@ volatile uint8 DATA radioMacState = RADIO_MAC_STATE_OFF;
 volatile uint8 DATA savedRadioMacState;
 volatile uint8 DATA savedWOREVT1;
 
+// The DMA channel that is being used for the current radio packet:
+// DMA_CHANNEL_RADIO or DMA_CHANNEL_RADIO_ALT.
+static volatile uint8 DATA radioDmaChannel = DMA_CHANNEL_RADIO;
+
+// 1 iff radioMacRxNext was called during the current call to radioMacEventHandler.
+static volatile BIT rxNextReady = 0;
+
+// 1 iff radioMacRx was called during the current call to radioMacEventHandler.
+static volatile BIT rxRestart = 0;
+
+// The MCSM0.FS_AUTOCAL bits.
+#define MCSM0_FS_AUTOCAL_MASK  0x30
+#define MCSM0_FS_AUTOCAL_IDLE  0x10  // Calibrate when going from IDLE to RX or TX.
+
+// This is defined in time.c.  We read it directly instead of calling getMs because getMs
+// is not reentrant, and the Timer 4 interrupt can not run while we are in the RF ISR anyway.
+extern PDATA volatile uint32 timeMs;
+
+#ifdef RADIO_MAC_TRACE
+// Timer 4 counts from 0 to 187 every millisecond (see time.c).
+#define TRACE_TICKS_PER_MS  188
+
+static RADIO_MAC_TRACE_ENTRY XDATA traceBuffer[RADIO_MAC_TRACE_SIZE];
+static volatile uint8 DATA traceMainLoopIndex = 0;   // The index of the next entry to read from the main loop.
+static volatile uint8 DATA traceInterruptIndex = 0;  // The index of the next entry to write in the RF ISR.
+volatile uint8 radioMacTraceLostCount = 0;
+
+static uint16 DATA traceIsrMs;     // The time when the current RF ISR started.
+static uint8 DATA traceIsrTicks;
+static uint16 DATA traceNowMs;     // The time read by the last call to traceNow.
+static uint8 DATA traceNowTicks;
+
+// Reads the current time into traceNowMs and traceNowTicks.
+// Assumption: This is called from the RF ISR, so timeMs will not change.
+static void traceNow()
+{
+    traceNowTicks = T4CNT;
+    traceNowMs = (uint16)timeMs;
+    if (T4IF && traceNowTicks < TRACE_TICKS_PER_MS/2)
+    {
+        // Timer 4 overflowed, but its interrupt has not run yet to increment timeMs.
+        traceNowMs++;
+    }
+}
+
+// Records the time when the current RF ISR started.
+static void traceStart()
+{
+    traceNow();
+    traceIsrMs = traceNowMs;
+    traceIsrTicks = traceNowTicks;
+}
+
+// Returns the number of Timer 4 ticks from the given time until now, or 255 if
+// it was longer than that.  Also updates traceNowMs and traceNowTicks.
+static uint8 traceTicksSince(uint16 ms, uint8 ticks)
+{
+    uint16 elapsed;
+
+    traceNow();
+    switch((uint16)(traceNowMs - ms))
+    {
+    case 0: elapsed = traceNowTicks - ticks; break;
+    case 1: elapsed = TRACE_TICKS_PER_MS + traceNowTicks - ticks; break;
+    default: return 255;
+    }
+    return elapsed > 255 ? 255 : (uint8)elapsed;
+}
+
+// Adds an entry to the trace buffer, unless it is full.
+static void traceRecord(uint8 event, uint8 latency, uint8 duration)
+{
+    RADIO_MAC_TRACE_ENTRY XDATA * entry;
+    uint8 nextIndex = (traceInterruptIndex + 1) & (RADIO_MAC_TRACE_SIZE - 1);
+
+    if (nextIndex == traceMainLoopIndex)
+    {
+        INCREMENT_ERROR_COUNT(radioMacTraceLostCount);
+        return;
+    }
+
+    entry = &traceBuffer[traceInterruptIndex];
+    entry->ms = traceIsrMs;
+    entry->ticks = traceIsrTicks;
+    entry->event = event;
+    entry->state = radioMacState;
+    entry->latency = latency;
+    entry->duration = duration;
+    traceInterruptIndex = nextIndex;
+}
+#endif
+
 ISR(RF, 0)
 {
+#ifdef RADIO_MAC_TRACE
+    traceStart();
+#endif
+
     S1CON = 0; // Clear the general RFIF interrupt registers
 
     if (RFIF & 0x10) // Check IRQ_DONE
@@ -68,19 +233,70 @@ ISR(RF, 0)
             // We just sent a packet.
             radioMacEvent(RADIO_MAC_EVENT_TX);
         }
+        else if (radioMacState == RADIO_MAC_STATE_RX && addressFilterOn && !radioMacRxAligned())
+        {
+            // The SFD interrupt below restarted the DMA too late, so the DMA missed the
+            // length byte and the packet is garbage.  Throw it away.
+            INCREMENT_ERROR_COUNT(radioMacCrcErrorCount);
+            RFIF = (uint8)(~0x11);  // Clear IRQ_DONE and IRQ_SFD.
+            radioMacRxRestart();
+        }
         else if (radioMacState == RADIO_MAC_STATE_RX)
         {
             // We just received a packet, but it might have an invalid CRC or be irrelevant
             // for other reasons.
-            radioMacEvent(RADIO_MAC_EVENT_RX);
+            if (!radioCrcPassed())
+            {
+                INCREMENT_ERROR_COUNT(radioMacCrcErrorCount);
+            }
+
+            if (rxNextReady)
+            {
+                // The DMA for the next packet is ready, so start receiving it right away.
+                radioMacRxContinue();
+            }
+            else
+            {
+                radioMacEvent(RADIO_MAC_EVENT_RX);
+            }
         }
     }
 
     if (RFIF & 0x20)  // Check IRQ_TIMEOUT
     {
-        // We were listening for packets but we didn't receive anything
-        // and the timeout period expired.
-        radioMacEvent(RADIO_MAC_EVENT_RX_TIMEOUT);
+        if (rxTimeoutHidden)
+        {
+            // The higher-level code asked for no timeout (see ADDRESS_FILTER_RX_TIMEOUT).
+            // If there is a strobe, it is handled below; otherwise keep listening.
+            RFIF = (uint8)(~0x21);  // Clear IRQ_TIMEOUT and IRQ_SFD.
+            if (!strobe)
+            {
+                radioMacRxRestart();
+            }
+        }
+        else
+        {
+            // We were listening for packets but we didn't receive anything
+            // and the timeout period expired.
+            INCREMENT_ERROR_COUNT(radioMacRxTimeoutCount);
+            radioMacEvent(RADIO_MAC_EVENT_RX_TIMEOUT);
+        }
+    }
+
+    if (RFIF & 0x01)  // Check IRQ_SFD (only enabled when address filtering is on)
+    {
+        RFIF = (uint8)(~0x01);
+
+        if (addressFilterOn && radioMacState == RADIO_MAC_STATE_RX)
+        {
+            // The radio detected the start of a packet.  If the previous packet was
+            // rejected by the address filter, the DMA has already read its first
+            // bytes, so restart the DMA transfer before any bytes of this packet arrive.
+            // This only works if this interrupt runs within one byte time of the SFD;
+            // radioMacRxAligned catches the packets for which it did not.
+            DMAARM = 0x80 | (1<<radioDmaChannel);
+            DMAARM |= (1<<radioDmaChannel);
+        }
     }
 
     if (strobe)
@@ -100,8 +316,10 @@ ISR(RF, 0)
             {
                 // We are currently receiving a packet, so we will wait for the end of that
                 // packet and then issue a RADIO_MAC_EVENT_RX.
-                // ASSUMPTION: There is no automatic address filtering, and packets with
-                // bad CRCs still result in a RAIDO_MAC_EVENT_RX.
+                // ASSUMPTION: Packets with bad CRCs still result in a RAIDO_MAC_EVENT_RX.
+                // If the packet is rejected by the address filter, there will be no
+                // RADIO_MAC_EVENT_RX, so the strobe will be handled in the next interrupt
+                // (the SFD interrupt of the next packet or the ADDRESS_FILTER_RX_TIMEOUT).
                 return;
             }
             if ((MCSM2&7) != 7 && WOREVT1 < MAX_LATENCY_OF_STROBE)
@@ -136,6 +354,7 @@ ISR(RF, 0)
         // TX underflow.  This should not happen because we use DMA to send
         // the data.  Report it as an error.
         radioTxUnderflowOccurred = 1;
+        INCREMENT_ERROR_COUNT(radioMacTxUnderflowCount);
         RFIF = ~0x80;
     }
 
@@ -145,17 +364,20 @@ ISR(RF, 0)
         // We were not reading data from the radio fast enough, so there was
         // a RX overflow.  This should not happen.  Report it as an error.
         radioRxOverflowOccurred = 1;
+        INCREMENT_ERROR_COUNT(radioMacRxOverflowCount);
         RFIF = (uint8)(~0x40);
 
-        // The radio module is probably now in the RX_OVERFLOW state where it can not
-        // receive packets.  The way to get out of this state is:
-        //RFST = SIDLE;  (and you probably should put NOPs here, though in my tests it was not necessary)
-        //RFST = SRX;
-        // We never expect an RX overflow to happen though, so we won't do that.
+        if (MARCSTATE == 0x11)
+        {
+            // The radio module is in the RX_OVERFLOW state where it can not
+            // receive packets, so get it out of that state.
+            radioMacRecoverFromOverflow();
+        }
     }
 }
 
-void radioMacEvent(uint8 event)
+// Turns off the radio and disarms the radio DMA channels.
+static void radioMacStop()
 {
     /** Turn off the radio. ****************************************************/
     /* This is necessary because David has observed that sometimes (maybe every
@@ -169,15 +391,118 @@ void radioMacEvent(uint8 event)
         RFST = SFSTXON;
     }
 
-    /** Disarm the DMA channel. ************************************************/
-    DMAARM = 0x80 | (1<<DMA_CHANNEL_RADIO); // Abort any ongoing radio DMA transfer.
-    DMAIRQ &= ~(1<<DMA_CHANNEL_RADIO);      // Clear any pending radio DMA interrupt
+    if (autoCalibrationOn)
+    {
+        // The calibration we requested in radioMacCalibrateIfNeeded is done.
+        MCSM0 = (MCSM0 & ~MCSM0_FS_AUTOCAL_MASK) | savedAutoCalibration;
+        autoCalibrationOn = 0;
+    }
 
-    /** Report the event to the higher-level code so it can decide what to do. **/
-    radioMacState = RADIO_MAC_STATE_RX;    // Default next state: RX
-    MCSM2 = 0x07;                          // Default next timeout: infinite.
-    radioMacEventHandler(event);
+    /** Disarm the DMA channels. ***********************************************/
+    // Abort any ongoing radio DMA transfer.
+    DMAARM = 0x80 | (1<<DMA_CHANNEL_RADIO) | (1<<DMA_CHANNEL_RADIO_ALT);
+    // Clear any pending radio DMA interrupt.
+    DMAIRQ &= ~((1<<DMA_CHANNEL_RADIO) | (1<<DMA_CHANNEL_RADIO_ALT));
+}
+
+// Gets the radio out of the RX_OVERFLOW state and restarts the current
+// radio DMA transfer from the beginning, without involving the higher-level code.
+// The partially received packet is lost.
+static void radioMacRecoverFromOverflow()
+{
+    RFST = SIDLE;
+    __asm nop __endasm;   // Give the radio time to get to IDLE.
+    __asm nop __endasm;
+    __asm nop __endasm;
+
+    DMAARM = 0x80 | (1<<radioDmaChannel);  // Abort the radio DMA transfer.
+    DMAIRQ &= ~(1<<radioDmaChannel);
+    RFIF = (uint8)(~0x10);                 // Clear IRQ_DONE in case it was set by the bad packet.
+
+    switch(radioMacState)
+    {
+    case RADIO_MAC_STATE_RX:
+        DMAARM |= (1<<radioDmaChannel);    // Re-arm DMA channel (the descriptor is reloaded).
+        RFST = SRX;                        // Switch radio to RX.
+        break;
+    case RADIO_MAC_STATE_TX:
+        DMAARM |= (1<<radioDmaChannel);
+        RFST = STX;
+        break;
+    }
+}
+
+// Throws away whatever the current radio DMA transfer received and puts the radio
+// back in RX mode, without involving the higher-level code.
+// Assumption: The radio is not receiving a packet.
+static void radioMacRxRestart()
+{
+    DMAARM = 0x80 | (1<<radioDmaChannel);  // Abort the radio DMA transfer.
+    DMAIRQ &= ~(1<<radioDmaChannel);
+    DMAARM |= (1<<radioDmaChannel);        // Re-arm DMA channel (the descriptor is reloaded).
+    RFST = SRX;                            // Switch radio to RX.
+}
+
+// Returns non-zero if the packet that was just received with address filtering on
+// looks like it was stored starting at its length byte: the length is allowed by
+// PKTLEN and the address byte after it is one that the filter accepts.
+static uint8 radioMacRxAligned()
+{
+    volatile DMA_CONFIG XDATA * config = (radioDmaChannel == DMA_CHANNEL_RADIO) ? &dmaConfig.radio : &dmaConfig.radioAlt;
+    uint8 XDATA * packet = (uint8 XDATA *)((config->DESTADDRH << 8) | config->DESTADDRL);
+    uint8 address = packet[1];
+    uint8 mode = PKTCTRL1 & 0x03;
+
+    if (packet[0] == 0 || packet[0] > PKTLEN)
+    {
+        return 0;
+    }
+
+    return address == ADDR ||
+        (address == 0x00 && mode >= RADIO_MAC_ADDRESS_CHECK_BROADCAST_00) ||
+        (address == 0xFF && mode == RADIO_MAC_ADDRESS_CHECK_BROADCAST_00_FF);
+}
 
+// Decides whether it is time to calibrate the frequency synthesizer, and if so,
+// arranges for the calibration to happen when the radio is started next.
+// Assumption: The radio is in IDLE or FSTXON and is about to be strobed into RX or TX.
+// Assumption: The Timer 4 interrupt can not run (we read timeMs).
+static void radioMacCalibrateIfNeeded()
+{
+    if (eventsSinceCalibration != 255)
+    {
+        eventsSinceCalibration++;
+    }
+
+    if (radioMacCalibrationScheduled)
+    {
+        // Never calibrate automatically; we decide when to calibrate below.
+        MCSM0 &= ~MCSM0_FS_AUTOCAL_MASK;
+    }
+
+    if (calibrateSoon || (radioMacCalibrationScheduled &&
+        ((radioMacCalibrationEventInterval != 0 && eventsSinceCalibration >= radioMacCalibrationEventInterval) ||
+        (radioMacCalibrationMsInterval != 0 && (uint16)((uint16)timeMs - lastCalibrationTime) >= radioMacCalibrationMsInterval))))
+    {
+        // The radio only calibrates when going from IDLE to RX or TX.
+        RFST = SIDLE;
+        savedAutoCalibration = MCSM0 & MCSM0_FS_AUTOCAL_MASK;
+        MCSM0 = (MCSM0 & ~MCSM0_FS_AUTOCAL_MASK) | MCSM0_FS_AUTOCAL_IDLE;
+        autoCalibrationOn = 1;
+
+#ifdef RADIO_MAC_TRACE
+        traceRecord(RADIO_MAC_TRACE_CALIBRATION, 0, 0);
+#endif
+
+        calibrateSoon = 0;
+        eventsSinceCalibration = 0;
+        lastCalibrationTime = (uint16)timeMs;
+    }
+}
+
+// Starts up the radio in the state that was decided by radioMacEventHandler.
+static void radioMacStart()
+{
     if (sleepRadioMac)
     {
         IEN2 &= ~0x01;    // Disable RF general interrupt
@@ -191,17 +516,28 @@ void radioMacEvent(uint8 event)
     // We want to do it before restarting the radio (to avoid accidentally missing
     // an event) but we want to do it as long as possible AFTER turning off the
     // radio.
-    RFIF = (uint8)(~0x30);  // Clear IRQ_DONE and IRQ_TIMEOUT if they are set.
+    RFIF = (uint8)(~0x31);  // Clear IRQ_DONE, IRQ_TIMEOUT, and IRQ_SFD if they are set.
 
     /** Start up the radio in the new state which was decided above. **/
     switch(radioMacState)
     {
     case RADIO_MAC_STATE_RX:
-        DMAARM = (1<<DMA_CHANNEL_RADIO);    // Arm DMA channel.
+        rxTimeoutHidden = 0;
+        if (addressFilterOn && (MCSM2 & 7) == 7)
+        {
+            MCSM2 = 0x00;   // See ADDRESS_FILTER_RX_TIMEOUT.
+            WORCTRL = 0;
+            WOREVT1 = ADDRESS_FILTER_RX_TIMEOUT;
+            WOREVT0 = 0;
+            rxTimeoutHidden = 1;
+        }
+        radioMacCalibrateIfNeeded();
+        DMAARM |= (1<<radioDmaChannel);     // Arm DMA channel (without disarming the others).
         RFST = SRX;                         // Switch radio to RX.
         break;
     case RADIO_MAC_STATE_TX:
-        DMAARM = (1<<DMA_CHANNEL_RADIO);    // Arm DMA channel.
+        radioMacCalibrateIfNeeded();
+        DMAARM |= (1<<radioDmaChannel);     // Arm DMA channel (without disarming the others).
         RFST = STX;                         // Switch radio to TX.
         break;
     case RADIO_MAC_STATE_IDLE:
@@ -213,12 +549,168 @@ void radioMacEvent(uint8 event)
     strobe = 0;
 }
 
+// Puts the radio in RX mode briefly to see if the channel is clear.
+// Returns non-zero if it is clear (or if the radio could not get to RX mode to check).
+// Assumption: The radio is in IDLE or FSTXON.
+static uint8 radioMacChannelClear()
+{
+    uint8 clear = 1;
+    uint16 timeout = CCA_RX_TIMEOUT;
+    uint8 savedMcsm1 = MCSM1;
+
+    // The CCA bit only means something while we are checking the channel, so the
+    // CCA mode is only set here.
+    MCSM1 = savedMcsm1 | MCSM1_CCA_MODE_MASK;
+
+    RFST = SRX;
+    while(MARCSTATE != 0x0D && --timeout)  // Wait for the radio to get to RX.
+    {
+        delayMicroseconds(1);
+    }
+
+    if (MARCSTATE == 0x0D)
+    {
+        delayMicroseconds(CCA_SETTLE_TIME);
+        clear = PKTSTATUS & (1<<4);  // Read the CCA bit (see MCSM1.CCA_MODE).
+    }
+
+    // Get out of RX before any packet data arrives, because the DMA is not set up for it.
+    RFST = SFSTXON;
+    MCSM1 = savedMcsm1;
+
+    return clear;
+}
+
+// If the higher-level code decided to transmit, but listen before talk is enabled
+// and the channel is busy, tells the higher-level code so it can decide what to do instead.
+static void radioMacCheckChannel()
+{
+    if (radioMacState == RADIO_MAC_STATE_TX && radioMacListenBeforeTalk && !radioMacChannelClear())
+    {
+        INCREMENT_ERROR_COUNT(radioMacChannelBusyCount);
+        radioMacState = RADIO_MAC_STATE_RX;
+        MCSM2 = 0x07;
+        rxNextReady = 0;
+        radioMacCallHandler(RADIO_MAC_EVENT_TX_BUSY);
+    }
+}
+
+// Calls the higher-level code's radioMacEventHandler, timing it in radio_mac_trace.lib.
+static void radioMacCallHandler(uint8 event)
+{
+#ifdef RADIO_MAC_TRACE
+    uint16 startMs;
+    uint8 startTicks;
+    uint8 latency;
+
+    latency = traceTicksSince(traceIsrMs, traceIsrTicks);
+    startMs = traceNowMs;
+    startTicks = traceNowTicks;
+    radioMacEventHandler(event);
+    traceRecord(event, latency, traceTicksSince(startMs, startTicks));
+#else
+    radioMacEventHandler(event);
+#endif
+}
+
+void radioMacEvent(uint8 event)
+{
+    radioMacStop();
+
+    /** Report the event to the higher-level code so it can decide what to do. **/
+    radioMacState = RADIO_MAC_STATE_RX;    // Default next state: RX
+    MCSM2 = 0x07;                          // Default next timeout: infinite.
+    rxNextReady = 0;
+    radioMacCallHandler(event);
+    radioMacCheckChannel();
+
+    radioMacStart();
+}
+
+// Called when a packet is received and the DMA for the next packet was set up
+// ahead of time by radioMacRxNext.
+static void radioMacRxContinue()
+{
+    uint8 finishedChannel = radioDmaChannel;
+
+    /** Start receiving the next packet right away. ****************************/
+    radioDmaChannel = (finishedChannel == DMA_CHANNEL_RADIO) ? DMA_CHANNEL_RADIO_ALT : DMA_CHANNEL_RADIO;
+    DMAARM = 0x80 | (1<<finishedChannel);  // Abort the old transfer (it should be done already).
+    DMAIRQ &= ~(1<<finishedChannel);
+    DMAARM |= (1<<radioDmaChannel);       // Arm the DMA channel for the next packet.
+    RFIF = (uint8)(~0x11);                // Clear IRQ_DONE and IRQ_SFD.
+    RFST = SRX;                           // Switch radio to RX (from FSTXON this is fast).
+
+    /** Report the event to the higher-level code. *****************************/
+    radioMacState = RADIO_MAC_STATE_RX;
+    rxNextReady = 0;
+    rxRestart = 0;
+    radioMacCallHandler(RADIO_MAC_EVENT_RX);
+
+    if (radioMacState == RADIO_MAC_STATE_RX && !rxRestart && !sleepRadioMac)
+    {
+        // The higher-level code wants to keep receiving, and the radio is already
+        // doing that.
+        strobe = 0;
+        return;
+    }
+
+    // The higher-level code wants the radio to do something else, so stop it
+    // (losing any packet that was being received) and start it in the new state.
+    radioMacStop();
+    radioMacCheckChannel();
+    radioMacStart();
+}
+
+#ifdef RADIO_MAC_TRACE
+uint8 radioMacTraceRead(RADIO_MAC_TRACE_ENTRY XDATA * entry)
+{
+    RADIO_MAC_TRACE_ENTRY XDATA * source;
+
+    if (traceMainLoopIndex == traceInterruptIndex)
+    {
+        return 0;
+    }
+
+    // The ISR does not write to this entry until we advance traceMainLoopIndex.
+    source = &traceBuffer[traceMainLoopIndex];
+    entry->ms = source->ms;
+    entry->ticks = source->ticks;
+    entry->event = source->event;
+    entry->state = source->state;
+    entry->latency = source->latency;
+    entry->duration = source->duration;
+    traceMainLoopIndex = (traceMainLoopIndex + 1) & (RADIO_MAC_TRACE_SIZE - 1);
+    return 1;
+}
+#endif
+
 void radioMacStrobe()
 {
     strobe = 1;
     S1CON |= 3;
 }
 
+void radioMacAddressFilter(uint8 address, uint8 mode)
+{
+    ADDR = address;
+    PKTCTRL1 = (PKTCTRL1 & ~0x03) | (mode & 0x03);  // Set PKTCTRL1.ADR_CHK.
+    addressFilterOn = (mode != RADIO_MAC_ADDRESS_CHECK_OFF);
+    if (addressFilterOn)
+    {
+        RFIM |= 0x01;   // Enable the SFD interrupt.
+    }
+    else
+    {
+        RFIM &= ~0x01;  // Disable the SFD interrupt.
+    }
+}
+
+void radioMacCalibrateSoon()
+{
+    calibrateSoon = 1;
+}
+
 void radioMacSleep()
 {
 	sleepRadioMac = 1;
@@ -237,16 +729,32 @@ void radioMacResume()
         WOREVT0 = 0;
 	}
 
+    T4IE = 0;   // Keep timeMs from changing while radioMacCalibrateIfNeeded reads it.
+
+#ifdef RADIO_MAC_TRACE
+    // The calibration below gets traced with this time.
+    traceStart();
+#endif
+
+    // The temperature might have changed a lot while we were asleep.
+    calibrateSoon = 1;
+    if (radioMacState == RADIO_MAC_STATE_RX || radioMacState == RADIO_MAC_STATE_TX)
+    {
+        radioMacCalibrateIfNeeded();
+    }
+
+    T4IE = 1;
+
     IEN2 |= 0x01;    // Enable RF general interrupt
 
     switch(radioMacState)
     {
 		case RADIO_MAC_STATE_RX:
-			DMAARM |= (1<<DMA_CHANNEL_RADIO);   // Arm DMA channel.
+			DMAARM |= (1<<radioDmaChannel);     // Arm DMA channel.
 			RFST = SRX;                         // Switch radio to RX.
 			break;
 		case RADIO_MAC_STATE_TX:
-			DMAARM |= (1<<DMA_CHANNEL_RADIO);   // Arm DMA channel.
+			DMAARM |= (1<<radioDmaChannel);     // Arm DMA channel.
 			RFST = STX;                         // Switch radio to TX.
 			break;
     }
@@ -258,8 +766,10 @@ void radioMacInit()
 {
     radioRegistersInit();
 
-    // MCSM.FS_AUTOCAL = 1: Calibrate freq when going from IDLE to RX or TX (or FSTXON).
+    // MCSM.FS_AUTOCAL = 1: Calibrate when going from IDLE to RX or TX.  If
+    // radioMacCalibrationScheduled is set, radioMacCalibrateIfNeeded turns it off.
     MCSM0 = 0x14;    // Main Radio Control State Machine Configuration
+    calibrateSoon = 1;
     MCSM1 = 0x05;    // Disable CCA.  After RX, go to FSTXON.  After TX, go to FSTXON.
     MCSM2 = 0x07;    // NOTE: MCSM2 also gets set every time we go into RX mode.
 
@@ -269,6 +779,20 @@ void radioMacInit()
     EA = 1;          // Enable interrupts in general
 
     dmaConfig.radio.DC6 = 19; // WORDSIZE = 0, TMODE = 0, TRIG = 19
+    dmaConfig.radioAlt.DC6 = 19;
+}
+
+// Sets up a DMA channel to receive a packet from the radio.
+static void radioMacRxDmaSetup(volatile DMA_CONFIG XDATA * config, uint8 XDATA * packet)
+{
+    config->SRCADDRH = XDATA_SFR_ADDRESS(RFD) >> 8;
+    config->SRCADDRL = XDATA_SFR_ADDRESS(RFD);
+    config->DESTADDRH = (unsigned int)packet >> 8;
+    config->DESTADDRL = (unsigned int)packet;
+    config->LENL = 1 + PKTLEN + 2;
+    config->VLEN_LENH = 0b10000000; // Transfer length is FirstByte+3
+    // Assumption: DC6 is set correctly
+    config->DC7 = 0x10; // SRCINC = 0, DESTINC = 1, IRQMASK = 0, M8 = 0, PRIORITY = 0
 }
 
 void radioMacRx(uint8 XDATA * packet, uint8 timeout)
@@ -285,18 +809,35 @@ void radioMacRx(uint8 XDATA * packet, uint8 timeout)
         MCSM2 = 0x07;  // RX_TIME = 7: No timeout.
     }
 
-    dmaConfig.radio.SRCADDRH = XDATA_SFR_ADDRESS(RFD) >> 8;
-    dmaConfig.radio.SRCADDRL = XDATA_SFR_ADDRESS(RFD);
-    dmaConfig.radio.DESTADDRH = (unsigned int)packet >> 8;
-    dmaConfig.radio.DESTADDRL = (unsigned int)packet;
-    dmaConfig.radio.LENL = 1 + PKTLEN + 2;
-    dmaConfig.radio.VLEN_LENH = 0b10000000; // Transfer length is FirstByte+3
-    // Assumption: DC6 is set correctly
-    dmaConfig.radio.DC7 = 0x10; // SRCINC = 0, DESTINC = 1, IRQMASK = 0, M8 = 0, PRIORITY = 0
+    radioMacRxDmaSetup(&dmaConfig.radio, packet);
+    radioDmaChannel = DMA_CHANNEL_RADIO;
+    rxRestart = 1;
 
     radioMacState = RADIO_MAC_STATE_RX;
 }
 
+// Called by the user during radioMacEventHandler, after deciding to receive, to set
+// up the DMA for the packet after the one that the radio is about to receive.
+void radioMacRxNext(uint8 XDATA * packet)
+{
+    if (radioDmaChannel == DMA_CHANNEL_RADIO)
+    {
+        radioMacRxDmaSetup(&dmaConfig.radioAlt, packet);
+    }
+    else
+    {
+        radioMacRxDmaSetup(&dmaConfig.radio, packet);
+    }
+    rxNextReady = 1;
+}
+
+// Called by the user during radioMacEventHandler to turn the radio off until the
+// next call to radioMacStrobe.
+void radioMacIdle()
+{
+    radioMacState = RADIO_MAC_STATE_IDLE;
+}
+
 // Called by the user during RADIO_MAC_STATE_IDLE or RADIO_MAC_STATE_RX to tell the Mac
 // that it should start trying to send a packet.
 void radioMacTx(uint8 XDATA * packet)
@@ -309,6 +850,7 @@ void radioMacTx(uint8 XDATA * packet)
     dmaConfig.radio.VLEN_LENH = 0b00100000; // Transfer length is FirstByte+1
     // Assumption: DC6 is set correctly
     dmaConfig.radio.DC7 = 0x40; // SRCINC = 1, DESTINC = 0, IRQMASK = 0, M8 = 0, PRIORITY = 0
+    radioDmaChannel = DMA_CHANNEL_RADIO;
 
     radioMacState = RADIO_MAC_STATE_TX;
 }
@@ -0,0 +1,141 @@
+/* radio_mac_hop.c:
+ *  Optional part of radio_mac.lib that helps higher-level libraries hop between
+ *  several channels.  It keeps the hop sequence and statistics that are used to
+ *  blacklist channels with a lot of interference.  The frequency synthesizer
+ *  calibration of each channel is kept by the channel cache in radio_registers.
+ */
+
+#include <radio_mac.h>
+#include <radio_registers.h>
+
+// The error rate (0-255) above which a channel gets blacklisted, and the error
+// rate it has to drop below to be used again.
+#define BLACKLIST_THRESHOLD   96
+#define WHITELIST_THRESHOLD   48
+
+uint8 XDATA radioMacHopErrorRate[RADIO_MAC_HOP_MAX_CHANNELS];
+uint16 radioMacHopBlacklist = 0;
+
+static uint8 XDATA hopChannel[RADIO_MAC_HOP_MAX_CHANNELS];   // CHANNR value for each hop index.
+static uint8 DATA hopCount = 0;
+static uint8 DATA hopBlacklistCount = 0;
+static uint8 DATA hopCurrent = 0xFF;   // The hop index of the channel the radio is on (0xFF = none).
+
+void radioMacHopInit(uint8 firstChannel, uint8 count)
+{
+    uint8 i, j, tmp;
+    uint8 seed = firstChannel;
+    uint8 spacing;
+
+    if (count > RADIO_MAC_HOP_MAX_CHANNELS)
+    {
+        count = RADIO_MAC_HOP_MAX_CHANNELS;
+    }
+    if (count == 0)
+    {
+        count = 1;
+    }
+    hopCount = count;
+
+    // Spread the channels evenly over the whole band.
+    spacing = (uint16)256 / count;
+    for (i = 0; i < count; i++)
+    {
+        hopChannel[i] = firstChannel + i * spacing;
+        radioMacHopErrorRate[i] = 0;
+    }
+
+    // Shuffle them into a pseudo-random order that only depends on firstChannel,
+    // so every Wixel that uses the same parameters gets the same sequence.
+    for (i = count - 1; i > 0; i--)
+    {
+        seed = seed * 109 + 89;
+        j = seed % (i + 1);
+        tmp = hopChannel[i];
+        hopChannel[i] = hopChannel[j];
+        hopChannel[j] = tmp;
+    }
+
+    radioChannelCacheInit(hopChannel, count);
+
+    // The channel cache turns off automatic calibration, so radio_mac has to decide
+    // when to calibrate the channel we are on.
+    radioMacCalibrationScheduled = 1;
+
+    radioMacHopBlacklist = 0;
+    hopBlacklistCount = 0;
+    hopCurrent = 0xFF;
+}
+
+uint8 radioMacHopChannel(uint8 index)
+{
+    return hopChannel[index];
+}
+
+void radioMacHopTo(uint8 index)
+{
+    if (index == hopCurrent)
+    {
+        return;
+    }
+
+    hopCurrent = index;
+
+    // The channel cache also saves any calibrations that radio_mac did while
+    // we were on the previous channel.
+    if (!radioChannelCacheSelect(index))
+    {
+        // This is the first time we use this channel.
+        radioMacCalibrateSoon();
+    }
+
+    if (radioMacHopBlacklist & (1 << index))
+    {
+        // Give blacklisted channels a chance to be used again after a while.
+        radioMacHopErrorRate[index] -= radioMacHopErrorRate[index] >> 4;
+        if (radioMacHopErrorRate[index] < WHITELIST_THRESHOLD)
+        {
+            radioMacHopBlacklist &= ~(1 << index);
+            hopBlacklistCount--;
+        }
+    }
+}
+
+void radioMacHopRecord(uint8 success)
+{
+    uint8 rate;
+
+    if (hopCurrent == 0xFF)
+    {
+        return;
+    }
+
+    // Exponential moving average of the error rate with a weight of 1/8.
+    rate = radioMacHopErrorRate[hopCurrent];
+    rate -= rate >> 3;
+    if (!success)
+    {
+        rate += 31;
+    }
+    radioMacHopErrorRate[hopCurrent] = rate;
+
+    if (radioMacHopBlacklist & (1 << hopCurrent))
+    {
+        if (rate < WHITELIST_THRESHOLD)
+        {
+            radioMacHopBlacklist &= ~(1 << hopCurrent);
+            hopBlacklistCount--;
+        }
+    }
+    else if (rate > BLACKLIST_THRESHOLD && hopBlacklistCount < hopCount / 2)
+    {
+        // Blacklist this channel, but always keep at least half of the channels.
+        radioMacHopBlacklist |= (1 << hopCurrent);
+        hopBlacklistCount++;
+    }
+}
+
+uint8 radioMacHopUsable(uint8 index)
+{
+    return !(radioMacHopBlacklist & (1 << index));
+}
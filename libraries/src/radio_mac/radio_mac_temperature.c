@@ -0,0 +1,50 @@
+/* radio_mac_temperature.c:
+ *  Optional part of radio_mac.lib that requests a calibration of the frequency
+ *  synthesizer when the temperature changes.  It is in a separate file so that
+ *  apps that do not use it do not need adc.lib.
+ */
+
+#include <radio_mac.h>
+#include <adc.h>
+#include <time.h>
+
+// Channel 14 of the ADC is the internal temperature sensor.
+#define TEMPERATURE_CHANNEL  (14 | ADC_REFERENCE_INTERNAL)
+
+// Minimum time between temperature readings, in milliseconds.
+#define TEMPERATURE_CHECK_PERIOD  1000
+
+uint16 radioMacCalibrationTemperatureDrift = 40;
+
+static BIT temperatureMeasured = 0;
+static uint16 lastCheckTime;
+static uint16 calibrationTemperature;   // ADC reading when we last requested a calibration.
+
+void radioMacCalibrationTemperatureService()
+{
+    uint16 temperature;
+
+    if (temperatureMeasured && (uint16)(getMs() - lastCheckTime) < TEMPERATURE_CHECK_PERIOD)
+    {
+        return;
+    }
+    lastCheckTime = (uint16)getMs();
+
+    temperature = adcRead(TEMPERATURE_CHANNEL);
+
+    if (!temperatureMeasured)
+    {
+        // radioMacInit already requested a calibration at the current temperature.
+        calibrationTemperature = temperature;
+        temperatureMeasured = 1;
+        return;
+    }
+
+    if (radioMacCalibrationTemperatureDrift != 0 &&
+        (temperature >= calibrationTemperature + radioMacCalibrationTemperatureDrift ||
+        temperature + radioMacCalibrationTemperatureDrift <= calibrationTemperature))
+    {
+        radioMacCalibrateSoon();
+        calibrationTemperature = temperature;
+    }
+}
@@ -0,0 +1,15 @@
+# This library is the instrumented build of radio_mac.
+# Apps select it by listing radio_mac_trace.lib instead of radio_mac.lib
+# in their APP_LIBS.
+LIB_RELS := libraries/src/radio_mac_trace/radio_mac_trace.rel libraries/src/radio_mac/radio_mac_temperature.rel libraries/src/radio_mac/radio_mac_hop.rel
+
+# When the rel (object) file is compiled, there will be a special
+# preprocessor flag to enable the event trace.
+libraries/src/radio_mac_trace/radio_mac_trace.rel : C_FLAGS += -DRADIO_MAC_TRACE
+
+# The rel file will be compiled from radio_mac_trace.c,
+# which will be a copy of radio_mac/radio_mac.c.
+libraries/src/radio_mac_trace/radio_mac_trace.c : libraries/src/radio_mac/radio_mac.c
+	$(CP) $< $@
+
+TARGETS += libraries/src/radio_mac_trace/radio_mac_trace.c
@@ -0,0 +1,375 @@
+/* radio_mesh.c:
+ *  This layer uses radio_queue.c to send packets over several hops.  Every packet has a
+ *  six byte header after the radio_queue length byte:
+ *
+ *    DEST       The address of the Wixel the packet is for (or RADIO_MESH_BROADCAST).
+ *    SRC        The address of the Wixel that sent the packet originally.
+ *    SEQ        A sequence number chosen by SRC, used to suppress duplicates.
+ *    TTL_COST   The number of hops the packet can still take (bits 7:4) and the cost
+ *               of the path it has taken so far (bits 3:0).
+ *    NEXT_HOP   The address of the neighbor that should relay the packet (or
+ *               RADIO_MESH_BROADCAST if any neighbor should relay it).
+ *    PREV_HOP   The address of the Wixel that transmitted this copy of the packet.
+ *
+ *  The routing table is learned backwards: a packet from SRC that arrives from PREV_HOP
+ *  shows that PREV_HOP is a way to get to SRC, with the cost in TTL_COST plus the cost
+ *  of the last hop, which we compute from the RSSI.
+ *
+ *  Like radio_link, the payload length that the higher-level code writes at the start of
+ *  the payload overwrites the last byte of the header (PREV_HOP), so radioMeshTxSendPacket
+ *  reads it before filling in the header, and we write it there for received packets
+ *  after we are done with the header.
+ */
+
+#include <radio_mesh.h>
+#include <radio_registers.h>
+#include <time.h>
+
+/* PARAMETERS *****************************************************************/
+
+int32 CODE param_radio_address = 0;
+int32 CODE param_radio_mesh_ttl = 4;
+
+/* PACKET VARIABLES AND DEFINES ***********************************************/
+
+#define RADIO_MESH_PACKET_HEADER_LENGTH 6
+
+#if RADIO_QUEUE_PAYLOAD_SIZE <= RADIO_MESH_PACKET_HEADER_LENGTH
+#error "RADIO_QUEUE_PAYLOAD_SIZE is too small to hold the mesh header."
+#endif
+
+#define RADIO_MESH_PACKET_LENGTH_OFFSET   0
+#define RADIO_MESH_PACKET_DEST_OFFSET     1
+#define RADIO_MESH_PACKET_SRC_OFFSET      2
+#define RADIO_MESH_PACKET_SEQ_OFFSET      3
+#define RADIO_MESH_PACKET_TTL_COST_OFFSET 4
+#define RADIO_MESH_PACKET_NEXT_HOP_OFFSET 5
+#define RADIO_MESH_PACKET_PREV_HOP_OFFSET 6
+
+#define TTL_BIT_OFFSET  4
+#define COST_MASK       0x0F
+#define MAX_COST        15
+
+// Routes that have not been refreshed for this many units of 256 ms (about a minute)
+// are removed from the table.
+#define ROUTE_TIMEOUT   234
+
+// The number of (source, sequence number) pairs remembered for duplicate suppression.
+#define DUPLICATE_CACHE_SIZE 16
+
+/* ROUTING VARIABLES **********************************************************/
+
+typedef struct MESH_ROUTE
+{
+    uint8 destination;  // RADIO_MESH_BROADCAST means this entry is unused.
+    uint8 nextHop;
+    uint8 cost;
+    uint8 time;         // When the route was last refreshed, in units of 256 ms.
+} MESH_ROUTE;
+
+static MESH_ROUTE XDATA routes[RADIO_MESH_MAX_ROUTES];
+
+static uint8 XDATA duplicateSource[DUPLICATE_CACHE_SIZE];
+static uint8 XDATA duplicateSeq[DUPLICATE_CACHE_SIZE];
+static uint8 DATA duplicateIndex = 0;  // The next entry of the cache to replace.
+
+static uint8 DATA address;
+static uint8 DATA ttl;
+static uint8 DATA txSeq = 0;
+
+// 1 if the packet at the front of the radio_queue RX queue is for the higher-level code.
+static BIT rxReady = 0;
+
+/* GENERAL FUNCTIONS **********************************************************/
+
+void radioMeshInit()
+{
+    uint8 i;
+
+    address = param_radio_address;
+    ttl = (param_radio_mesh_ttl < 1) ? 1 :
+        (param_radio_mesh_ttl > 15) ? 15 : param_radio_mesh_ttl;
+
+    for (i = 0; i < RADIO_MESH_MAX_ROUTES; i++)
+    {
+        routes[i].destination = RADIO_MESH_BROADCAST;
+    }
+
+    for (i = 0; i < DUPLICATE_CACHE_SIZE; i++)
+    {
+        duplicateSource[i] = RADIO_MESH_BROADCAST;
+    }
+
+    radioQueueInit();
+}
+
+/* ROUTING FUNCTIONS **********************************************************/
+
+static uint8 routeNow()
+{
+    return (uint8)(getMs() >> 8);
+}
+
+// Returns the cost of a hop, from 1 to 4, based on the RSSI of a packet received on it.
+static uint8 hopCost(int8 rssi)
+{
+    if (rssi >= -60){ return 1; }
+    if (rssi >= -75){ return 2; }
+    if (rssi >= -85){ return 3; }
+    return 4;
+}
+
+// Removes the routes that have not been refreshed for a while.
+static void routesExpire()
+{
+    uint8 now = routeNow();
+    uint8 i;
+
+    for (i = 0; i < RADIO_MESH_MAX_ROUTES; i++)
+    {
+        if (routes[i].destination != RADIO_MESH_BROADCAST && (uint8)(now - routes[i].time) > ROUTE_TIMEOUT)
+        {
+            routes[i].destination = RADIO_MESH_BROADCAST;
+        }
+    }
+}
+
+// Returns the route to the given destination, or 0 if there is none.
+static MESH_ROUTE XDATA * routeFind(uint8 destination)
+{
+    uint8 i;
+
+    for (i = 0; i < RADIO_MESH_MAX_ROUTES; i++)
+    {
+        if (routes[i].destination == destination)
+        {
+            return &routes[i];
+        }
+    }
+    return 0;
+}
+
+// Records that the given destination can be reached through nextHop with the given cost,
+// if that is at least as good as what we know.
+static void routeLearn(uint8 destination, uint8 nextHop, uint8 cost)
+{
+    MESH_ROUTE XDATA * route = routeFind(destination);
+    uint8 now = routeNow();
+
+    if (route == 0)
+    {
+        // Use a free entry, or replace the one that was refreshed least recently.
+        uint8 i;
+        route = &routes[0];
+        for (i = 0; i < RADIO_MESH_MAX_ROUTES; i++)
+        {
+            if (routes[i].destination == RADIO_MESH_BROADCAST)
+            {
+                route = &routes[i];
+                break;
+            }
+            if ((uint8)(now - routes[i].time) > (uint8)(now - route->time))
+            {
+                route = &routes[i];
+            }
+        }
+    }
+    else if (route->nextHop != nextHop && cost > route->cost)
+    {
+        // We already have a cheaper route through a different neighbor.
+        return;
+    }
+
+    route->destination = destination;
+    route->nextHop = nextHop;
+    route->cost = cost;
+    route->time = now;
+}
+
+uint8 radioMeshNextHop(uint8 destination)
+{
+    MESH_ROUTE XDATA * route;
+
+    if (destination == RADIO_MESH_BROADCAST || !(route = routeFind(destination)))
+    {
+        return RADIO_MESH_BROADCAST;
+    }
+    return route->nextHop;
+}
+
+// Returns 1 if we have already seen the given packet.  Otherwise, remembers it and returns 0.
+static BIT duplicateCheck(uint8 source, uint8 seq)
+{
+    uint8 i;
+
+    for (i = 0; i < DUPLICATE_CACHE_SIZE; i++)
+    {
+        if (duplicateSource[i] == source && duplicateSeq[i] == seq)
+        {
+            return 1;
+        }
+    }
+
+    duplicateSource[duplicateIndex] = source;
+    duplicateSeq[duplicateIndex] = seq;
+    duplicateIndex = (duplicateIndex + 1) & (DUPLICATE_CACHE_SIZE - 1);
+    return 0;
+}
+
+/* TX FUNCTIONS ***************************************************************/
+
+uint8 radioMeshTxAvailable(void)
+{
+    return radioQueueTxAvailable();
+}
+
+uint8 XDATA * radioMeshTxCurrentPacket(void)
+{
+    uint8 XDATA * packet = radioQueueTxCurrentPacket();
+    if (packet == 0)
+    {
+        return 0;
+    }
+    return packet + RADIO_MESH_PACKET_HEADER_LENGTH;
+}
+
+void radioMeshTxSendPacket(uint8 destination)
+{
+    uint8 XDATA * packet = radioQueueTxCurrentPacket();
+
+    // Read the payload length before the header overwrites it.
+    packet[RADIO_MESH_PACKET_LENGTH_OFFSET] = packet[RADIO_MESH_PACKET_HEADER_LENGTH] + RADIO_MESH_PACKET_HEADER_LENGTH;
+
+    packet[RADIO_MESH_PACKET_DEST_OFFSET] = destination;
+    packet[RADIO_MESH_PACKET_SRC_OFFSET] = address;
+    packet[RADIO_MESH_PACKET_SEQ_OFFSET] = txSeq++;
+    packet[RADIO_MESH_PACKET_TTL_COST_OFFSET] = ttl << TTL_BIT_OFFSET;
+    packet[RADIO_MESH_PACKET_NEXT_HOP_OFFSET] = radioMeshNextHop(destination);
+    packet[RADIO_MESH_PACKET_PREV_HOP_OFFSET] = address;
+
+    radioQueueTxSendPacket();
+}
+
+/* RX FUNCTIONS ***************************************************************/
+
+// Copies a packet we received into the TX queue to pass it on to the next hop.
+// Returns 0 if there is no room in the TX queue.
+static BIT relayPacket(uint8 XDATA * rxPacket, uint8 cost)
+{
+    uint8 XDATA * txPacket = radioQueueTxCurrentPacket();
+    uint8 length = rxPacket[RADIO_MESH_PACKET_LENGTH_OFFSET];
+    uint8 i;
+
+    if (txPacket == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i <= length; i++)
+    {
+        txPacket[i] = rxPacket[i];
+    }
+
+    txPacket[RADIO_MESH_PACKET_TTL_COST_OFFSET] = ((rxPacket[RADIO_MESH_PACKET_TTL_COST_OFFSET] - (1 << TTL_BIT_OFFSET)) & ~COST_MASK) | cost;
+    txPacket[RADIO_MESH_PACKET_NEXT_HOP_OFFSET] = radioMeshNextHop(rxPacket[RADIO_MESH_PACKET_DEST_OFFSET]);
+    txPacket[RADIO_MESH_PACKET_PREV_HOP_OFFSET] = address;
+
+    radioQueueTxSendPacket();
+    return 1;
+}
+
+void radioMeshService(void)
+{
+    uint8 XDATA * packet;
+
+    routesExpire();
+
+    // Each iteration of this loop processes one packet received on the radio.
+    // This loop stops when we are out of packets or a packet is ready for the
+    // higher-level code.
+    while (!rxReady && (packet = radioQueueRxCurrentPacket()))
+    {
+        uint8 length = packet[RADIO_MESH_PACKET_LENGTH_OFFSET];
+        uint8 source, destination, prevHop, linkCost, cost;
+        BIT forUs, relay;
+
+        source = packet[RADIO_MESH_PACKET_SRC_OFFSET];
+        if (length < RADIO_MESH_PACKET_HEADER_LENGTH || source == address)
+        {
+            // This packet was not sent by radio_mesh, or it is one of ours that a
+            // neighbor relayed.
+            radioQueueRxDoneWithPacket();
+            continue;
+        }
+
+        destination = packet[RADIO_MESH_PACKET_DEST_OFFSET];
+        prevHop = packet[RADIO_MESH_PACKET_PREV_HOP_OFFSET];
+
+        // The radio appends the RSSI of the packet after the data.
+        linkCost = hopCost(((int8)packet[1 + length]) / 2 - radioRssiOffset);
+        cost = (packet[RADIO_MESH_PACKET_TTL_COST_OFFSET] & COST_MASK) + linkCost;
+        if (cost > MAX_COST)
+        {
+            cost = MAX_COST;
+        }
+
+        routeLearn(prevHop, prevHop, linkCost);
+        routeLearn(source, prevHop, cost);
+
+        forUs = (destination == address || destination == RADIO_MESH_BROADCAST);
+        relay = (destination != address &&
+            (packet[RADIO_MESH_PACKET_NEXT_HOP_OFFSET] == address || packet[RADIO_MESH_PACKET_NEXT_HOP_OFFSET] == RADIO_MESH_BROADCAST) &&
+            (packet[RADIO_MESH_PACKET_TTL_COST_OFFSET] >> TTL_BIT_OFFSET) > 1);
+
+        if (relay && !forUs && !radioQueueTxAvailable())
+        {
+            // Leave the packet in the RX queue and try again when there is room.
+            return;
+        }
+
+        if (duplicateCheck(source, packet[RADIO_MESH_PACKET_SEQ_OFFSET]))
+        {
+            radioQueueRxDoneWithPacket();
+            continue;
+        }
+
+        if (relay)
+        {
+            // If the TX queue is full, a broadcast is still delivered to us but not relayed.
+            relayPacket(packet, cost);
+        }
+
+        if (forUs)
+        {
+            // Set the length byte that will be read by the higher-level code.
+            // (This overrides the last byte of the header.)
+            packet[RADIO_MESH_PACKET_HEADER_LENGTH] = length - RADIO_MESH_PACKET_HEADER_LENGTH;
+            rxReady = 1;
+        }
+        else
+        {
+            radioQueueRxDoneWithPacket();
+        }
+    }
+}
+
+uint8 XDATA * radioMeshRxCurrentPacket(void)
+{
+    radioMeshService();
+    if (!rxReady)
+    {
+        return 0;
+    }
+    return radioQueueRxCurrentPacket() + RADIO_MESH_PACKET_HEADER_LENGTH;
+}
+
+uint8 radioMeshRxCurrentSource(void)
+{
+    return radioQueueRxCurrentPacket()[RADIO_MESH_PACKET_SRC_OFFSET];
+}
+
+void radioMeshRxDoneWithPacket(void)
+{
+    rxReady = 0;
+    radioQueueRxDoneWithPacket();
+}
@@ -0,0 +1,143 @@
+/* radio_message.c:
+ *  This layer uses radio_link.c to send and receive messages that do not fit in
+ *  a single radio packet.  Each message is split into fragments, and each fragment
+ *  is sent as one radio_link data packet.  Since radio_link delivers data packets
+ *  reliably and in order, all the receiver has to do is append the fragments to its
+ *  buffer until it sees the last one.
+ *
+ *  The first byte of each fragment's payload is a header that says whether it is
+ *  the first and/or last fragment of a message, and its index in the message.
+ *  The index lets the receiver detect a message that was cut short (e.g. because
+ *  the other Wixel was reset in the middle of sending it).
+ */
+
+#include <radio_message.h>
+
+#define FRAGMENT_HEADER_FIRST       (1 << 7)
+#define FRAGMENT_HEADER_LAST        (1 << 6)
+#define FRAGMENT_HEADER_INDEX_MASK  0b00111111
+
+// The number of fragments needed to send a message of the given length.
+// Even an empty message needs one fragment.
+#define FRAGMENT_COUNT(length)  ((length) == 0 ? 1 : ((uint16)(length) + RADIO_MESSAGE_FRAGMENT_SIZE - 1) / RADIO_MESSAGE_FRAGMENT_SIZE)
+
+static uint8 XDATA rxMessage[RADIO_MESSAGE_MAX_SIZE];
+static uint8 rxLength = 0;         // The number of bytes in rxMessage.
+static uint8 rxNextIndex = 0;      // The index of the fragment we expect next.
+static BIT rxAssembling = 0;       // 1 if we have received the first fragment of a message but not the last.
+static BIT rxComplete = 0;         // 1 if rxMessage holds a complete message for the higher-level code.
+
+void radioMessageInit()
+{
+    radioLinkInit();
+}
+
+/** TX FUNCTIONS **************************************************************/
+
+BIT radioMessageTxAvailable(uint8 length)
+{
+    return length <= RADIO_MESSAGE_MAX_SIZE && radioLinkTxAvailable() >= FRAGMENT_COUNT(length);
+}
+
+void radioMessageTxSend(const uint8 XDATA * message, uint8 length)
+{
+    // Assumption: radioMessageTxAvailable(length) recently returned 1.
+    uint8 index = 0;
+
+    do
+    {
+        uint8 XDATA * packet = radioLinkTxCurrentPacket();
+        uint8 fragmentLength = length < RADIO_MESSAGE_FRAGMENT_SIZE ? length : RADIO_MESSAGE_FRAGMENT_SIZE;
+        uint8 i;
+
+        packet[0] = fragmentLength + 1;  // Payload length, including the fragment header.
+        packet[1] = index;
+        if (index == 0)
+        {
+            packet[1] |= FRAGMENT_HEADER_FIRST;
+        }
+        if (fragmentLength == length)
+        {
+            packet[1] |= FRAGMENT_HEADER_LAST;
+        }
+
+        for (i = 0; i < fragmentLength; i++)
+        {
+            packet[2 + i] = *message++;
+        }
+
+        radioLinkTxSendPacket(RADIO_MESSAGE_PAYLOAD_TYPE);
+
+        length -= fragmentLength;
+        index++;
+    } while (length);
+}
+
+/** RX FUNCTIONS **************************************************************/
+
+// Each iteration of this loop processes one packet received on the radio.
+// This loop stops when we are out of packets or when a message is complete.
+static void receiveMorePackets(void)
+{
+    uint8 XDATA * packet;
+
+    while (!rxComplete && (packet = radioLinkRxCurrentPacket()))
+    {
+        if (radioLinkRxCurrentPayloadType() == RADIO_MESSAGE_PAYLOAD_TYPE && packet[0] != 0)
+        {
+            uint8 header = packet[1];
+            uint8 fragmentLength = packet[0] - 1;
+
+            if (header & FRAGMENT_HEADER_FIRST)
+            {
+                // Start a new message, discarding any partial one.
+                rxAssembling = 1;
+                rxLength = 0;
+                rxNextIndex = 0;
+            }
+
+            if (rxAssembling &&
+                (header & FRAGMENT_HEADER_INDEX_MASK) == rxNextIndex &&
+                (uint16)rxLength + fragmentLength <= RADIO_MESSAGE_MAX_SIZE)
+            {
+                uint8 i;
+                for (i = 0; i < fragmentLength; i++)
+                {
+                    rxMessage[rxLength + i] = packet[2 + i];
+                }
+                rxLength += fragmentLength;
+                rxNextIndex = (rxNextIndex + 1) & FRAGMENT_HEADER_INDEX_MASK;
+
+                if (header & FRAGMENT_HEADER_LAST)
+                {
+                    rxAssembling = 0;
+                    rxComplete = 1;
+                }
+            }
+            else
+            {
+                // We missed part of this message, so discard the rest of it.
+                rxAssembling = 0;
+            }
+        }
+
+        radioLinkRxDoneWithPacket();
+    }
+}
+
+uint8 XDATA * radioMessageRxCurrentMessage(void)
+{
+    receiveMorePackets();
+    return rxComplete ? rxMessage : 0;
+}
+
+uint8 radioMessageRxCurrentLength(void)
+{
+    return rxLength;
+}
+
+void radioMessageRxDoneWithMessage(void)
+{
+    rxComplete = 0;
+    receiveMorePackets();
+}
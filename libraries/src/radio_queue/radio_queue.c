@@ -14,9 +14,25 @@
  *  Radio_queue is essentially a stripped-down version of the radio_link
  *  library, so radio_link is a good alternative if you want a more specialized
  *  implementation with more features.
+ *
+ *  If RADIO_QUEUE_TDMA is defined (radio_queue_tdma.lib), packets are not sent
+ *  after random delays; instead, each device only transmits in its own time
+ *  slot of a frame that is synchronized with beacons from the coordinator.
+ *  See radio_queue_tdma.h.
+ *
+ *  If RADIO_QUEUE_WOR is defined (radio_queue_wor.lib), the radio only listens
+ *  for a short window in each wake-up period, and each packet is sent
+ *  repeatedly for a whole period so that the receivers hear it.
+ *  See radio_queue_wor.h.
  */
 
 #include <radio_queue.h>
+#ifdef RADIO_QUEUE_TDMA
+#include <radio_queue_tdma.h>
+#endif
+#ifdef RADIO_QUEUE_WOR
+#include <radio_queue_wor.h>
+#endif
 #include <radio_registers.h>
 #include <random.h>
 
@@ -24,20 +40,62 @@
 
 int32 CODE param_radio_channel = 128;
 
+#ifdef RADIO_QUEUE_TDMA
+int32 CODE param_radio_tdma_slot = 1;
+int32 CODE param_radio_tdma_slot_count = 8;
+int32 CODE param_radio_hop_channels = 1;
+#endif
+
+#ifdef RADIO_QUEUE_WOR
+int32 CODE param_radio_wor_period = 100;
+#endif
+
 /* PACKET VARIABLES AND DEFINES ***********************************************/
 
 // Compute the max size of on-the-air packets.  This value is stored in the PKTLEN register.
 #define RADIO_MAX_PACKET_SIZE  (RADIO_QUEUE_PAYLOAD_SIZE)
 
+#if RADIO_QUEUE_PAYLOAD_SIZE < 1 || RADIO_QUEUE_PAYLOAD_SIZE > 255
+#error "RADIO_QUEUE_PAYLOAD_SIZE must be between 1 and 255."
+#endif
+
+// The number of packet buffers.  An app can change these by defining them in
+// the APP_C_FLAGS of its options.mk (see apps.mk).
+#ifndef RADIO_QUEUE_RX_PACKET_COUNT
+#define RADIO_QUEUE_RX_PACKET_COUNT 3
+#endif
+
+#ifndef RADIO_QUEUE_TX_PACKET_COUNT
+#define RADIO_QUEUE_TX_PACKET_COUNT 16
+#endif
+
+#ifndef RADIO_QUEUE_TX_URGENT_PACKET_COUNT
+#define RADIO_QUEUE_TX_URGENT_PACKET_COUNT 4
+#endif
+
+#if RADIO_QUEUE_RX_PACKET_COUNT < 2 || RADIO_QUEUE_RX_PACKET_COUNT > 255
+#error "RADIO_QUEUE_RX_PACKET_COUNT must be between 2 and 255."
+#endif
+
+// The TX indices are wrapped with a mask, so the TX rings must be powers of 2.
+#if RADIO_QUEUE_TX_PACKET_COUNT < 2 || RADIO_QUEUE_TX_PACKET_COUNT > 128 || (RADIO_QUEUE_TX_PACKET_COUNT & (RADIO_QUEUE_TX_PACKET_COUNT - 1))
+#error "RADIO_QUEUE_TX_PACKET_COUNT must be a power of 2 between 2 and 128."
+#endif
+
+#if RADIO_QUEUE_TX_URGENT_PACKET_COUNT < 2 || RADIO_QUEUE_TX_URGENT_PACKET_COUNT > 64 || (RADIO_QUEUE_TX_URGENT_PACKET_COUNT & (RADIO_QUEUE_TX_URGENT_PACKET_COUNT - 1))
+#error "RADIO_QUEUE_TX_URGENT_PACKET_COUNT must be a power of 2 between 2 and 64."
+#endif
+
 #define RADIO_QUEUE_PACKET_LENGTH_OFFSET 0
 
 /*  rxPackets:
  *  We need to be prepared at all times to receive a full packet from another
- *  party, even if we cannot give it to the main loop.  Therefore, we need (at
- *  least) THREE buffers, so that two can be owned by the main loop while
- *  another is owned by the ISR and ready to receive the next packet.
+ *  party, even if we cannot give it to the main loop.  Therefore, we need at
+ *  least TWO buffers, so that one can be owned by the main loop while
+ *  another is owned by the ISR and ready to receive the next packet.  By
+ *  default there are three, so the main loop can hold on to two of them.
  *
- *  If a packet is received and the main loop still owns the other two buffers,
+ *  If a packet is received and the main loop still owns all the other buffers,
  *  we discard it.
  *
  *  Ownership of the RX packet buffers is determined from radioQueueRxMainLoopIndex and radioQueueRxInterruptIndex.
@@ -49,79 +107,475 @@ int32 CODE param_radio_channel = 128;
  *                0 |                1 | rxBuffer[0]
  *                0 |                2 | rxBuffer[0 and 1]
  */
-#define RX_PACKET_COUNT  3
-static volatile uint8 XDATA radioQueueRxPacket[RX_PACKET_COUNT][1 + RADIO_MAX_PACKET_SIZE + 2];  // The first byte is the length.
+#define RX_PACKET_COUNT  RADIO_QUEUE_RX_PACKET_COUNT
+static volatile uint8 XDATA radioQueueRxStorage[RX_PACKET_COUNT][RADIO_QUEUE_RX_BUFFER_SIZE];  // The first byte is the length.
+
+// The buffer used for each RX slot.  These start out pointing to radioQueueRxStorage, but
+// radioQueueRxTakePacket swaps the main loop's current buffer with one from the caller.
+static uint8 XDATA * XDATA radioQueueRxPacket[RX_PACKET_COUNT];
 static volatile uint8 DATA radioQueueRxMainLoopIndex = 0;   // The index of the next rxBuffer to read from the main loop.
 static volatile uint8 DATA radioQueueRxInterruptIndex = 0;  // The index of the next rxBuffer to write to when a packet comes from the radio.
 
-/* txPackets are handled similarly */
-#define TX_PACKET_COUNT 16
-static volatile uint8 XDATA radioQueueTxPacket[TX_PACKET_COUNT][1 + RADIO_MAX_PACKET_SIZE];  // The first byte is the length.
-static volatile uint8 DATA radioQueueTxMainLoopIndex = 0;   // The index of the next txPacket to write to in the main loop.
-static volatile uint8 DATA radioQueueTxInterruptIndex = 0;  // The index of the current txPacket we are trying to send on the radio.
+/* txPackets are handled similarly, but there is a separate ring for each priority class
+ * so that urgent packets do not wait behind normal ones.  The rings are stored one after
+ * the other in radioQueueTxPacket: the ring for priority p starts at txRingStart[p], and
+ * its size (a power of 2) is txRingMask[p] + 1.  The indices are relative to the start
+ * of the ring. */
+#define TX_PACKET_COUNT         RADIO_QUEUE_TX_PACKET_COUNT
+#define TX_URGENT_PACKET_COUNT  RADIO_QUEUE_TX_URGENT_PACKET_COUNT
+static uint8 CODE txRingStart[RADIO_QUEUE_PRIORITY_COUNT] = { 0, TX_PACKET_COUNT };
+static uint8 CODE txRingMask[RADIO_QUEUE_PRIORITY_COUNT] = { TX_PACKET_COUNT - 1, TX_URGENT_PACKET_COUNT - 1 };
+static volatile uint8 XDATA radioQueueTxPacket[TX_PACKET_COUNT + TX_URGENT_PACKET_COUNT][1 + RADIO_MAX_PACKET_SIZE];  // The first byte is the length.
+static volatile uint8 DATA radioQueueTxMainLoopIndex[RADIO_QUEUE_PRIORITY_COUNT];   // The index of the next txPacket to write to in the main loop.
+static volatile uint8 DATA radioQueueTxInterruptIndex[RADIO_QUEUE_PRIORITY_COUNT];  // The index of the current txPacket we are trying to send on the radio.
+
+// The priority class of the packet we are sending (see txSelect).  Only used in the ISR.
+static uint8 DATA txPriority = 0;
+
+static BIT txSelect(void);
+static uint8 XDATA * txCurrentPacket(void);
 
 BIT radioQueueAllowCrcErrors = 0;
 
+// 1 iff radioMacRxNext was called for the RX buffer after radioQueueRxInterruptIndex,
+// which means that if the next event is RADIO_MAC_EVENT_RX then the radio is already
+// receiving into that buffer.
+static BIT rxNextPrepared = 0;
+
+/* TDMA VARIABLES AND DEFINES *************************************************/
+
+#ifdef RADIO_QUEUE_TDMA
+
+// Timer 3 interrupts once per tick: 250 * 128 / 24 MHz = 1.333 ms.
+#define TDMA_TICKS_PER_SLOT 2
+
+// RX timeouts, in units of 0.922 ms (the units of radioMacRx).
+// A node starts listening for the beacon at the start of the last slot of the frame,
+// and listens for the coordinator's packet for a while after the beacon.
+#define TDMA_BEACON_TIMEOUT    6
+#define TDMA_DOWNLINK_TIMEOUT  3
+
+// A node that misses this many beacons in a row is no longer synchronized.
+// When hopping, the coordinator does not send beacons on blacklisted channels,
+// so half of the hop channels are added to this.
+#define TDMA_MAX_BEACONS_MISSED 4
+
+static uint8 DATA tdmaSlotNumber;     // The slot of this device.  0 means it is the coordinator.
+static uint8 DATA tdmaSlotCount;      // The number of slots in a frame.
+static uint8 DATA tdmaHopCount;       // The number of channels to hop between.  1 means no hopping.
+static uint8 DATA tdmaMaxBeaconsMissed;
+static volatile uint8 DATA tdmaSlot = 0;  // The current slot.
+static volatile uint8 DATA tdmaTick = 0;  // The number of ticks since the start of the current slot.
+static volatile uint8 DATA tdmaHopIndex = 0;     // The hop index of the current frame's channel.
+static volatile uint8 DATA tdmaParkFrames = 0;   // Unsynchronized node: frames spent on this channel.
+
+// Nodes start out unsynchronized (see tdmaInit).
+static volatile uint8 DATA tdmaBeaconsMissed;
+
+static volatile BIT tdmaSlotUsed = 0;       // 1 iff we sent a data packet during the current slot.
+static volatile BIT tdmaHopPending = 0;     // 1 iff the radio needs to move to the channel of tdmaHopIndex.
+static volatile BIT tdmaBeaconHeard = 0;    // Node: 1 iff we received the beacon of the current frame.
+static volatile BIT tdmaBeaconSent = 0;     // Coordinator: 1 iff we sent the beacon of the current frame.
+static volatile BIT tdmaSendingBeacon = 0;  // Coordinator: 1 iff the radio is sending a beacon.
+
+static uint8 XDATA tdmaBeaconPacket[1];   // A packet with no payload.
+
+#endif
+
+/* TDMA FUNCTIONS *************************************************************/
+
+#ifdef RADIO_QUEUE_TDMA
+
+static void tdmaInit()
+{
+    tdmaSlotCount = (param_radio_tdma_slot_count < 2) ? 2 :
+        (param_radio_tdma_slot_count > 255) ? 255 : param_radio_tdma_slot_count;
+
+    tdmaSlotNumber = (param_radio_tdma_slot < 0) ? 0 :
+        (param_radio_tdma_slot >= tdmaSlotCount) ? tdmaSlotCount - 1 : param_radio_tdma_slot;
+
+    tdmaHopCount = (param_radio_hop_channels < 1) ? 1 :
+        (param_radio_hop_channels > RADIO_MAC_HOP_MAX_CHANNELS) ? RADIO_MAC_HOP_MAX_CHANNELS : param_radio_hop_channels;
+
+    tdmaMaxBeaconsMissed = TDMA_MAX_BEACONS_MISSED + tdmaHopCount / 2;
+    tdmaBeaconsMissed = tdmaMaxBeaconsMissed;
+
+    if (tdmaHopCount > 1)
+    {
+        radioMacHopInit(param_radio_channel, tdmaHopCount);
+        tdmaHopPending = 1;
+    }
+
+    tdmaBeaconPacket[0] = 0;
+
+    // Start Timer 3 with a period of 250 * 128 / 24 MHz = 1.333 ms.
+    T3CC0 = 249;
+    T3IE = 1;     // Enable Timer 3 interrupt.  (IEN1.T3IE=1)
+
+    // DIV=111: 1:128 prescaler
+    // START=1: Start the timer
+    // OVFIM=1: Enable the overflow interrupt.
+    // MODE=10: Modulo
+    T3CTL = 0b11111010;
+}
+
+uint8 radioQueueTdmaSynchronized()
+{
+    return tdmaSlotNumber == 0 || tdmaBeaconsMissed < tdmaMaxBeaconsMissed;
+}
+
+// Called at the start of each frame (from the Timer 3 ISR) to advance the hop sequence.
+static void tdmaNextHop()
+{
+    if (tdmaHopCount > 1)
+    {
+        if (++tdmaHopIndex >= tdmaHopCount)
+        {
+            tdmaHopIndex = 0;
+        }
+        tdmaHopPending = 1;
+    }
+}
+
+// Moves the radio to the channel of the current frame, if it is not there already.
+// Must be called from radioMacEventHandler.  Returns 1 if the radio was stopped
+// to change the channel.
+static uint8 tdmaHop()
+{
+    if (tdmaHopPending)
+    {
+        tdmaHopPending = 0;
+        radioMacHopTo(tdmaHopIndex);
+        return 1;
+    }
+    return 0;
+}
+
+ISR(T3, 0)
+{
+    if (++tdmaTick < TDMA_TICKS_PER_SLOT)
+    {
+        return;
+    }
+
+    // A new slot is starting.
+    tdmaTick = 0;
+    tdmaSlotUsed = 0;
+    if (++tdmaSlot >= tdmaSlotCount)
+    {
+        // A new frame is starting.  (A node normally starts a new frame when it
+        // receives the beacon, in tdmaSynchronize, before this happens.)
+        tdmaSlot = 0;
+        tdmaBeaconHeard = 0;
+    }
+
+    if (tdmaSlotNumber == 0)
+    {
+        if (tdmaSlot == 0)
+        {
+            // It is time to send the beacon.
+            tdmaBeaconSent = 0;
+            tdmaNextHop();
+            radioMacStrobe();
+        }
+        return;
+    }
+
+    if (tdmaBeaconsMissed >= tdmaMaxBeaconsMissed)
+    {
+        // We are not synchronized, so the radio is listening all the time anyway.
+        // When hopping, wait on each channel for one more frame than it takes the
+        // coordinator to visit every channel, and then try the next one.
+        if (tdmaHopCount > 1 && tdmaSlot == 0 && ++tdmaParkFrames > tdmaHopCount)
+        {
+            tdmaParkFrames = 0;
+            tdmaNextHop();
+            radioMacStrobe();
+        }
+        return;
+    }
+
+    if (tdmaSlot == tdmaSlotCount - 1)
+    {
+        // The beacon of the next frame is coming soon, so turn on the radio.
+        if (!tdmaBeaconHeard)
+        {
+            tdmaBeaconsMissed++;
+            if (tdmaHopCount > 1)
+            {
+                radioMacHopRecord(0);
+            }
+        }
+        tdmaNextHop();
+        radioMacStrobe();
+    }
+    else if (tdmaSlot == tdmaSlotNumber)
+    {
+        radioMacStrobe();
+    }
+}
+
+// Called when a node receives a beacon, which marks the start of slot 0.
+static void tdmaSynchronize()
+{
+    T3CTL |= 0x04;   // Clear the Timer 3 counter (T3CTL.CLR=1).
+    T3OVFIF = 0;
+    T3IF = 0;
+
+    tdmaTick = 0;
+    tdmaSlot = 0;
+    tdmaSlotUsed = 0;
+    tdmaBeaconHeard = 1;
+    tdmaBeaconsMissed = 0;
+    tdmaParkFrames = 0;
+
+    if (tdmaHopCount > 1)
+    {
+        radioMacHopRecord(1);
+    }
+}
+
+// Decides what the radio should do according to the TDMA schedule.
+// Returns 0 if the radio should just listen for packets with no timeout.
+static uint8 tdmaTakeInitiative()
+{
+    uint8 txPending = txSelect();
+
+    if (tdmaSlotNumber == 0)
+    {
+        // We are the coordinator.  Send the beacon and one data packet
+        // at the start of each frame, and listen the rest of the time.
+        if (tdmaHopCount > 1 && tdmaHop())
+        {
+            // The radio might have been receiving already (see rxPrepareNext),
+            // so make sure it gets restarted on the new channel.
+            radioMacRx(radioQueueRxPacket[radioQueueRxInterruptIndex], 0);
+        }
+
+        if (tdmaSlot == 0 && !tdmaBeaconSent)
+        {
+            if (tdmaHopCount > 1 && !radioMacHopUsable(tdmaHopIndex))
+            {
+                // The channel of this frame is blacklisted, so do not send a beacon.
+                // Nodes only transmit in frames that have a beacon, so this frame
+                // will not be used.
+                tdmaBeaconSent = 1;
+                tdmaSlotUsed = 1;
+            }
+            else
+            {
+                tdmaSendingBeacon = 1;
+                radioMacTx(tdmaBeaconPacket);
+                return 1;
+            }
+        }
+
+        if (tdmaSlot == 0 && txPending && !tdmaSlotUsed)
+        {
+            radioMacTx(txCurrentPacket());
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (tdmaBeaconsMissed >= tdmaMaxBeaconsMissed)
+    {
+        // We are not synchronized, so listen until we receive a beacon.
+        if (tdmaHopCount > 1 && tdmaHop())
+        {
+            radioMacRx(radioQueueRxPacket[radioQueueRxInterruptIndex], 0);
+        }
+        return 0;
+    }
+
+    if (tdmaSlot == tdmaSlotNumber && tdmaBeaconHeard && txPending && !tdmaSlotUsed)
+    {
+        // It is our slot, so send the next data packet.
+        radioMacTx(txCurrentPacket());
+        return 1;
+    }
+
+    if (tdmaSlot == tdmaSlotCount - 1)
+    {
+        // Listen for the beacon of the next frame, on the next channel.
+        if (tdmaHopCount > 1)
+        {
+            tdmaHop();
+        }
+        radioMacRx(radioQueueRxPacket[radioQueueRxInterruptIndex], TDMA_BEACON_TIMEOUT);
+        return 1;
+    }
+
+    // There is nothing for us to do in this slot, so turn off the radio.
+    radioMacIdle();
+    return 1;
+}
+
+#endif
+
+/* WAKE-ON-RADIO VARIABLES AND FUNCTIONS **************************************/
+
+#ifdef RADIO_QUEUE_WOR
+
+// The RX timeout for each listening window, in units of 0.922 ms (the units of
+// radioMacRx).  This must be long enough to see the start of one of the copies
+// of a packet that is being sent repeatedly.  A copy takes about 0.8 ms to send
+// with the default profile, but about 2.7 ms with RADIO_PROFILE_LONG_RANGE.
+#define WOR_LISTEN_TIMEOUT  (radioGetProfile() == RADIO_PROFILE_LONG_RANGE ? 5 : 2)
+
+// Extra time to keep sending copies of a packet, in ms, to make up for the time
+// it takes to start up the radio and receive a whole copy.
+#define WOR_TRAIN_EXTRA     (radioGetProfile() == RADIO_PROFILE_LONG_RANGE ? 6 : 3)
+
+static uint16 DATA worPeriod;                   // The wake-up period in ms.
+static volatile uint16 DATA worWakeCountdown = 0;  // The time in ms until we should listen again (0 = not counting).
+static volatile uint16 DATA worTrainTime = 0;   // The time in ms since we started sending the current packet.
+static volatile BIT worListenNow = 1;           // 1 iff it is time for a listening window.
+static volatile BIT worTraining = 0;            // 1 iff we are sending copies of the current packet.
+
+static void worInit()
+{
+    worPeriod = (param_radio_wor_period < 10) ? 10 :
+        (param_radio_wor_period > 10000) ? 10000 : param_radio_wor_period;
+
+    // Start Timer 3 with a period of 188 * 128 / 24 MHz = 1.003 ms.
+    T3CC0 = 187;
+    T3IE = 1;     // Enable Timer 3 interrupt.  (IEN1.T3IE=1)
+
+    // DIV=111: 1:128 prescaler
+    // START=1: Start the timer
+    // OVFIM=1: Enable the overflow interrupt.
+    // MODE=10: Modulo
+    T3CTL = 0b11111010;
+}
+
+ISR(T3, 0)
+{
+    if (worTraining)
+    {
+        worTrainTime++;
+    }
+
+    if (worWakeCountdown != 0 && --worWakeCountdown == 0)
+    {
+        worListenNow = 1;
+        radioMacStrobe();
+    }
+}
+
+// Decides what the radio should do when it has nothing else to do: listen
+// for a short time if a listening window is due, or turn off the radio.
+static void worTakeInitiative()
+{
+    if (worListenNow)
+    {
+        worListenNow = 0;
+        radioMacRx(radioQueueRxPacket[radioQueueRxInterruptIndex], WOR_LISTEN_TIMEOUT);
+        return;
+    }
+
+    if (worWakeCountdown == 0)
+    {
+        worWakeCountdown = worPeriod;
+    }
+    radioMacIdle();
+}
+
+#endif
+
 /* GENERAL FUNCTIONS **********************************************************/
 
 void radioQueueInit()
 {
+    uint8 i;
+
+    for (i = 0; i < RX_PACKET_COUNT; i++)
+    {
+        radioQueueRxPacket[i] = radioQueueRxStorage[i];
+    }
+
     randomSeedFromSerialNumber();
 
     PKTLEN = RADIO_MAX_PACKET_SIZE;
     CHANNR = param_radio_channel;
 
+#ifdef RADIO_QUEUE_TDMA
+    tdmaInit();
+#endif
+
+#ifdef RADIO_QUEUE_WOR
+    worInit();
+#endif
+
     radioMacInit();
     radioMacStrobe();
 }
 
+#ifndef RADIO_QUEUE_TDMA
 // Returns a random delay in units of 0.922 ms (the same units of radioMacRx).
 // This is used to decide when to next transmit a queued data packet.
 static uint8 randomTxDelay()
 {
     return 1 + (randomNumber() & 3);
 }
+#endif
 
 /* TX FUNCTIONS (called by higher-level code in main loop) ********************/
 
+uint8 radioQueuePriorityTxAvailable(uint8 priority)
+{
+    // Assumption: The size of each ring is a power of 2
+    return (radioQueueTxInterruptIndex[priority] - radioQueueTxMainLoopIndex[priority] - 1) & txRingMask[priority];
+}
+
 uint8 radioQueueTxAvailable(void)
 {
-    // Assumption: TX_PACKET_COUNT is a power of 2
-    return (radioQueueTxInterruptIndex - radioQueueTxMainLoopIndex - 1) & (TX_PACKET_COUNT - 1);
+    return radioQueuePriorityTxAvailable(RADIO_QUEUE_PRIORITY_NORMAL);
 }
 
 uint8 radioQueueTxQueued(void)
 {
-    return (radioQueueTxMainLoopIndex - radioQueueTxInterruptIndex) & (TX_PACKET_COUNT - 1);
+    uint8 queued = 0;
+    uint8 priority;
+
+    for (priority = 0; priority < RADIO_QUEUE_PRIORITY_COUNT; priority++)
+    {
+        queued += (radioQueueTxMainLoopIndex[priority] - radioQueueTxInterruptIndex[priority]) & txRingMask[priority];
+    }
+    return queued;
 }
 
-uint8 XDATA * radioQueueTxCurrentPacket()
+uint8 XDATA * radioQueuePriorityTxCurrentPacket(uint8 priority)
 {
-    if (!radioQueueTxAvailable())
+    if (!radioQueuePriorityTxAvailable(priority))
     {
         return 0;
     }
 
-    return radioQueueTxPacket[radioQueueTxMainLoopIndex];
+    return radioQueueTxPacket[txRingStart[priority] + radioQueueTxMainLoopIndex[priority]];
 }
 
-void radioQueueTxSendPacket(void)
+uint8 XDATA * radioQueueTxCurrentPacket()
+{
+    return radioQueuePriorityTxCurrentPacket(RADIO_QUEUE_PRIORITY_NORMAL);
+}
+
+void radioQueuePriorityTxSendPacket(uint8 priority)
 {
     // Update our index of which packet to populate in the main loop.
-    if (radioQueueTxMainLoopIndex == TX_PACKET_COUNT - 1)
-    {
-        radioQueueTxMainLoopIndex = 0;
-    }
-    else
-    {
-        radioQueueTxMainLoopIndex++;
-    }
+    radioQueueTxMainLoopIndex[priority] = (radioQueueTxMainLoopIndex[priority] + 1) & txRingMask[priority];
 
     // Make sure that radioMacEventHandler runs soon so it can see this new data and send it.
     // This must be done LAST.
     radioMacStrobe();
 }
 
+void radioQueueTxSendPacket(void)
+{
+    radioQueuePriorityTxSendPacket(RADIO_QUEUE_PRIORITY_NORMAL);
+}
+
 /* RX FUNCTIONS (called by higher-level code in main loop) ********************/
 
 uint8 XDATA * radioQueueRxCurrentPacket(void)
@@ -145,42 +599,149 @@ void radioQueueRxDoneWithPacket(void)
     }
 }
 
+uint8 XDATA * radioQueueRxTakePacket(uint8 XDATA * replacement)
+{
+    uint8 XDATA * packet = radioQueueRxCurrentPacket();
+    if (packet == 0)
+    {
+        return 0;
+    }
+
+    // The ISR does not look at this slot until radioQueueRxDoneWithPacket gives it back.
+    radioQueueRxPacket[radioQueueRxMainLoopIndex] = replacement;
+    radioQueueRxDoneWithPacket();
+    return packet;
+}
+
 /* FUNCTIONS CALLED IN RF_ISR *************************************************/
 
-static void takeInitiative()
+// Chooses the highest priority class that has a packet waiting and makes it the
+// class that txCurrentPacket and txDone refer to.  Returns 0 if no packets are waiting.
+static BIT txSelect()
 {
-    if (radioQueueTxInterruptIndex != radioQueueTxMainLoopIndex)
+    uint8 priority = RADIO_QUEUE_PRIORITY_COUNT;
+
+    while (priority--)
     {
-        // Try to send the next data packet.
-        radioMacTx(radioQueueTxPacket[radioQueueTxInterruptIndex]);
+        if (radioQueueTxInterruptIndex[priority] != radioQueueTxMainLoopIndex[priority])
+        {
+            txPriority = priority;
+            return 1;
+        }
     }
-    else
+    return 0;
+}
+
+// Returns the packet we are trying to send.
+static uint8 XDATA * txCurrentPacket()
+{
+    return radioQueueTxPacket[txRingStart[txPriority] + radioQueueTxInterruptIndex[txPriority]];
+}
+
+// Gives ownership of the packet we just sent back to the main loop.
+static void txDone()
+{
+    radioQueueTxInterruptIndex[txPriority] = (radioQueueTxInterruptIndex[txPriority] + 1) & txRingMask[txPriority];
+}
+
+// Sets up the RX buffer after radioQueueRxInterruptIndex to receive the packet after
+// the current one, if the main loop does not own that buffer.  The main loop can
+// only free up buffers, so the buffer will still be free when the packet arrives.
+static void rxPrepareNext()
+{
+    uint8 next = radioQueueRxInterruptIndex + 1;
+    if (next == RX_PACKET_COUNT)
+    {
+        next = 0;
+    }
+
+    if (next != radioQueueRxMainLoopIndex)
+    {
+        radioMacRxNext(radioQueueRxPacket[next]);
+        rxNextPrepared = 1;
+    }
+}
+
+// rxContinuing should be 1 if the radio is already receiving into
+// radioQueueRxPacket[radioQueueRxInterruptIndex].
+static void takeInitiative(uint8 rxContinuing)
+{
+#ifdef RADIO_QUEUE_TDMA
+    if (tdmaTakeInitiative())
+    {
+        return;
+    }
+#else
+    if (txSelect())
+    {
+        // Try to send the next data packet, from the highest priority class.
+#ifdef RADIO_QUEUE_WOR
+        if (!worTraining)
+        {
+            worTraining = 1;
+            worTrainTime = 0;
+        }
+#endif
+        radioMacTx(txCurrentPacket());
+        return;
+    }
+#endif
+
+#ifdef RADIO_QUEUE_WOR
+    worTakeInitiative();
+#else
+    if (!rxContinuing)
     {
         radioMacRx(radioQueueRxPacket[radioQueueRxInterruptIndex], 0);
     }
+    rxPrepareNext();
+#endif
 }
 
 void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
 {
+    uint8 rxContinuing = rxNextPrepared;
+    rxNextPrepared = 0;
+
     if (event == RADIO_MAC_EVENT_STROBE)
     {
-        takeInitiative();
+        takeInitiative(0);
         return;
     }
     else if (event == RADIO_MAC_EVENT_TX)
     {
-        // Give ownership of the current TX packet back to the main loop by updated radioQueueTxInterruptIndex.
-        if (radioQueueTxInterruptIndex == TX_PACKET_COUNT - 1)
+#ifdef RADIO_QUEUE_TDMA
+        if (tdmaSendingBeacon)
         {
-            radioQueueTxInterruptIndex = 0;
+            tdmaSendingBeacon = 0;
+            tdmaBeaconSent = 1;
+            takeInitiative(0);
+            return;
         }
-        else
+#endif
+
+#ifdef RADIO_QUEUE_WOR
+        if (worTrainTime < worPeriod + WOR_TRAIN_EXTRA)
         {
-            radioQueueTxInterruptIndex++;
+            // Keep sending copies of the packet until every receiver has had a
+            // listening window.
+            radioMacTx(txCurrentPacket());
+            return;
         }
+        worTraining = 0;
+#endif
+
+        // Give ownership of the current TX packet back to the main loop.
+        txDone();
 
+#ifdef RADIO_QUEUE_TDMA
+        // Only one data packet can be sent per slot.
+        tdmaSlotUsed = 1;
+        takeInitiative(0);
+#else
         // We sent a packet, so now let's give another party a chance to talk.
         radioMacRx(radioQueueRxPacket[radioQueueRxInterruptIndex], randomTxDelay());
+#endif
         return;
     }
     else if (event == RADIO_MAC_EVENT_RX)
@@ -189,7 +750,17 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
 
         if (!radioQueueAllowCrcErrors && !radioCrcPassed())
         {
-            if (radioQueueTxInterruptIndex != radioQueueTxMainLoopIndex)
+#if defined(RADIO_QUEUE_WOR)
+            // The packet was corrupted, but there might be another copy of it coming.
+            radioMacRx(currentRxPacket, WOR_LISTEN_TIMEOUT);
+#elif defined(RADIO_QUEUE_TDMA)
+            if (tdmaHopCount > 1 && tdmaSlotNumber == 0)
+            {
+                radioMacHopRecord(0);
+            }
+            takeInitiative(0);
+#else
+            if (txSelect())
             {
                 radioMacRx(currentRxPacket, randomTxDelay());
             }
@@ -197,8 +768,32 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
             {
                 radioMacRx(currentRxPacket, 0);
             }
+#endif
+            return;
+        }
+
+#ifdef RADIO_QUEUE_TDMA
+        if (tdmaHopCount > 1 && tdmaSlotNumber == 0 && radioCrcPassed())
+        {
+            radioMacHopRecord(1);
+        }
+
+        if (currentRxPacket[RADIO_QUEUE_PACKET_LENGTH_OFFSET] == 0 && tdmaSlotNumber != 0 && radioCrcPassed())
+        {
+            // We received a beacon, so slot 0 is starting.  Listen for a data
+            // packet from the coordinator.
+            tdmaSynchronize();
+            radioMacRx(currentRxPacket, TDMA_DOWNLINK_TIMEOUT);
             return;
         }
+#endif
+
+#ifdef RADIO_QUEUE_WOR
+        // The sender is probably still sending copies of this packet, so do not
+        // listen again until it is done.
+        worListenNow = 0;
+        worWakeCountdown = worPeriod + WOR_TRAIN_EXTRA;
+#endif
 
         if (currentRxPacket[RADIO_QUEUE_PACKET_LENGTH_OFFSET] > 0)
         {
@@ -220,15 +815,44 @@ void radioMacEventHandler(uint8 event) // called by the MAC in an ISR
             {
                 // We can accept this packet!
                 radioQueueRxInterruptIndex = nextradioQueueRxInterruptIndex;
+
+                // If rxContinuing is 1, the radio is already receiving into the new
+                // radioQueueRxPacket[radioQueueRxInterruptIndex], so keep it that way.
+                takeInitiative(rxContinuing);
+                return;
             }
         }
 
-        takeInitiative();
+        takeInitiative(0);
         return;
     }
     else if (event == RADIO_MAC_EVENT_RX_TIMEOUT)
     {
-        takeInitiative();
+        takeInitiative(0);
+        return;
+    }
+    else if (event == RADIO_MAC_EVENT_TX_BUSY)
+    {
+#ifdef RADIO_QUEUE_WOR
+        // Start sending the copies of the packet again later.
+        worTraining = 0;
+#endif
+#ifdef RADIO_QUEUE_TDMA
+        // The channel is busy, so give up on this slot and try again in the next frame.
+        if (tdmaSendingBeacon)
+        {
+            tdmaSendingBeacon = 0;
+            tdmaBeaconSent = 1;
+        }
+        else
+        {
+            tdmaSlotUsed = 1;
+        }
+        takeInitiative(0);
+#else
+        // The channel is busy, so listen for a while and try again later.
+        radioMacRx(radioQueueRxPacket[radioQueueRxInterruptIndex], randomTxDelay());
+#endif
         return;
     }
 }
@@ -0,0 +1,15 @@
+# This library is the TDMA (time-slotted) build of radio_queue.
+# Apps select it by listing radio_queue_tdma.lib instead of radio_queue.lib
+# in their APP_LIBS, and including radio_queue_tdma.h.
+LIB_RELS := libraries/src/radio_queue_tdma/radio_queue_tdma.rel
+
+# When the rel (object) file is compiled, there will be a special
+# preprocessor flag to enable the TDMA schedule.
+libraries/src/radio_queue_tdma/radio_queue_tdma.rel : C_FLAGS += -DRADIO_QUEUE_TDMA
+
+# The rel file will be compiled from radio_queue_tdma.c,
+# which will be a copy of radio_queue/radio_queue.c.
+libraries/src/radio_queue_tdma/radio_queue_tdma.c : libraries/src/radio_queue/radio_queue.c
+	$(CP) $< $@
+
+TARGETS += libraries/src/radio_queue_tdma/radio_queue_tdma.c
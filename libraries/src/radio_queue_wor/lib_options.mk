@@ -0,0 +1,15 @@
+# This library is the wake-on-radio (duty-cycled) build of radio_queue.
+# Apps select it by listing radio_queue_wor.lib instead of radio_queue.lib
+# in their APP_LIBS, and including radio_queue_wor.h.
+LIB_RELS := libraries/src/radio_queue_wor/radio_queue_wor.rel
+
+# When the rel (object) file is compiled, there will be a special
+# preprocessor flag to enable duty-cycled listening.
+libraries/src/radio_queue_wor/radio_queue_wor.rel : C_FLAGS += -DRADIO_QUEUE_WOR
+
+# The rel file will be compiled from radio_queue_wor.c,
+# which will be a copy of radio_queue/radio_queue.c.
+libraries/src/radio_queue_wor/radio_queue_wor.c : libraries/src/radio_queue/radio_queue.c
+	$(CP) $< $@
+
+TARGETS += libraries/src/radio_queue_wor/radio_queue_wor.c
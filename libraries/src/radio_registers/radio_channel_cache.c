@@ -0,0 +1,104 @@
+/* radio_channel_cache.c:
+ *  Optional part of radio_registers.lib that stores the frequency synthesizer
+ *  calibration (FSCAL3, FSCAL2, and FSCAL1) of several channels so the radio
+ *  can switch between them without calibrating every time.
+ */
+
+#include <radio_registers.h>
+#include <cc2511_map.h>
+
+// RFST command strobes.
+#define SCAL    1
+#define SIDLE   4
+
+static uint8 XDATA cacheChannel[RADIO_CHANNEL_CACHE_SIZE];   // CHANNR value for each index.
+static uint8 XDATA cacheFscal[RADIO_CHANNEL_CACHE_SIZE][3];  // FSCAL3, FSCAL2, FSCAL1 for each index.
+static uint16 cacheValid = 0;          // Bit n is 1 iff cacheFscal[n] holds a calibration.
+static uint8 DATA cacheCount = 0;
+static uint8 DATA cacheCurrent = 0xFF; // The index of the channel the radio is on (0xFF = none).
+
+static void radioIdle()
+{
+    RFST = SIDLE;
+    while(MARCSTATE != 0x01);
+}
+
+static void saveCalibration(uint8 index)
+{
+    cacheFscal[index][0] = FSCAL3;
+    cacheFscal[index][1] = FSCAL2;
+    cacheFscal[index][2] = FSCAL1;
+    cacheValid |= (1 << index);
+}
+
+void radioChannelCacheInit(const uint8 * channels, uint8 count)
+{
+    uint8 i;
+
+    if (count > RADIO_CHANNEL_CACHE_SIZE)
+    {
+        count = RADIO_CHANNEL_CACHE_SIZE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        cacheChannel[i] = channels[i];
+    }
+    cacheCount = count;
+    cacheValid = 0;
+    cacheCurrent = 0xFF;
+}
+
+void radioChannelCacheCalibrate()
+{
+    uint8 i;
+
+    radioIdle();
+    for (i = 0; i < cacheCount; i++)
+    {
+        CHANNR = cacheChannel[i];
+        RFST = SCAL;
+        while(MARCSTATE != 0x01);  // Wait for the calibration to finish (about 800 us).
+        saveCalibration(i);
+    }
+    cacheCurrent = cacheCount - 1;
+}
+
+uint8 radioChannelCacheSelect(uint8 index)
+{
+    if (index >= cacheCount)
+    {
+        return 0;
+    }
+
+    radioIdle();
+
+    // The calibration is only done automatically if FS_AUTOCAL is not 0,
+    // and that would overwrite the values we restore.
+    MCSM0 &= ~0x30;
+
+    if (index == cacheCurrent)
+    {
+        return 1;
+    }
+
+    // Save the calibration of the channel we are leaving, in case the radio was
+    // calibrated again while it was on that channel.
+    if (cacheCurrent != 0xFF)
+    {
+        saveCalibration(cacheCurrent);
+    }
+
+    CHANNR = cacheChannel[index];
+    cacheCurrent = index;
+
+    if (!(cacheValid & (1 << index)))
+    {
+        return 0;
+    }
+
+    FSCAL3 = cacheFscal[index][0];
+    FSCAL2 = cacheFscal[index][1];
+    FSCAL1 = cacheFscal[index][2];
+    return 1;
+}
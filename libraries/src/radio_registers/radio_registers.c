@@ -1,6 +1,33 @@
 #include <radio_registers.h>
 #include <cc2511_map.h>
 
+// RFST command strobes.
+#define SIDLE   4
+
+// The registers that are different in each PHY profile.
+typedef struct RADIO_PROFILE
+{
+    uint8 mdmcfg4;     // Channel bandwidth and data rate exponent.
+    uint8 mdmcfg3;     // Data rate mantissa.
+    uint8 fsctrl1;     // Intermediate frequency used in RX.
+    int8 rssiOffset;
+} RADIO_PROFILE;
+
+// Data rate = (256 + DRATE_M) * 2^DRATE_E * 24 MHz / 2^28
+// Channel bandwidth = 24 MHz / (8 * (4 + CHANBW_M) * 2^CHANBW_E)
+// We tried different data rates: 375 kbps was pretty good, but 400 kbps and above
+// caused lots of packet errors, so that is the fastest profile.
+static RADIO_PROFILE CODE radioProfiles[RADIO_PROFILE_COUNT] =
+{
+    { 0x5C, 0x11, 0x08, 71 },  // RADIO_PROFILE_LONG_RANGE: 99.98 kbps, bandwidth = 300 kHz.
+    { 0x1D, 0xDE, 0x0A, 71 },  // RADIO_PROFILE_DEFAULT: 350 kbps, bandwidth = 600 kHz.
+    { 0x1E, 0x00, 0x0A, 72 },  // RADIO_PROFILE_FAST: 375 kbps, bandwidth = 600 kHz.
+};
+
+static uint8 DATA currentProfile = RADIO_PROFILE_DEFAULT;
+
+int8 radioRssiOffset = RSSI_OFFSET;
+
 void BuiltInRadioRegistersInit();
 static pFnRadioRegistersInitFunc gpRadioRegistersInitFunc = 0;
 
@@ -45,14 +72,17 @@ void BuiltInRadioRegistersInit()
 
     // Controls the FREQ_IF used for RX.
     // This is affected by MDMCFG2.DEM_DCFILT_OFF according to p.212 of datasheet.
-    FSCTRL1 = 0x0A;  // Frequency Synthesizer Control
+    // FSCTRL1 is set by the profile below.
     FSCTRL0 = 0x00;  // Frequency Synthesizer Control
 
     // Sets the data rate (symbol rate) used in TX and RX.  See Sec 13.5 of the datasheet.
     // Also sets the channel bandwidth.
-    // We tried different data rates: 375 kbps was pretty good, but 400 kbps and above caused lots of packet errors.
-    // NOTE: If you change this, you must change RSSI_OFFSET in radio_registers.h
-    MDMCFG4 = 0x1D;  MDMCFG3 = 0xDE; // Modem configuration (data rate = 350 kbps, bandwidth = 600 kHz).
+    // The default profile is 350 kbps with a bandwidth of 600 kHz (MDMCFG4 = 0x1D, MDMCFG3 = 0xDE).
+    // NOTE: If you change the profiles, you must change their RSSI offsets.
+    MDMCFG4 = radioProfiles[currentProfile].mdmcfg4;  // Modem configuration
+    MDMCFG3 = radioProfiles[currentProfile].mdmcfg3;
+    FSCTRL1 = radioProfiles[currentProfile].fsctrl1;  // Frequency Synthesizer Control
+    radioRssiOffset = radioProfiles[currentProfile].rssiOffset;
 
     // MDMCFG2.DEM_DCFILT_OFF = 0, enable digital DC blocking filter before
     //   demodulator.  This affects the FREQ_IF according to p.212 of datasheet.
@@ -97,6 +127,31 @@ void BuiltInRadioRegistersInit()
     PKTCTRL0 = 0x45; // Enable data whitening, CRC, and variable length packets.
 }
 
+void radioSetProfile(uint8 profile)
+{
+    if (profile >= RADIO_PROFILE_COUNT)
+    {
+        return;
+    }
+
+    // The radio should only be reconfigured in the IDLE state.
+    RFST = SIDLE;
+    while(MARCSTATE != 0x01);
+
+    // The frequency synthesizer calibration does not depend on these registers,
+    // so there is no need to calibrate again.
+    currentProfile = profile;
+    MDMCFG4 = radioProfiles[profile].mdmcfg4;
+    MDMCFG3 = radioProfiles[profile].mdmcfg3;
+    FSCTRL1 = radioProfiles[profile].fsctrl1;
+    radioRssiOffset = radioProfiles[profile].rssiOffset;
+}
+
+uint8 radioGetProfile()
+{
+    return currentProfile;
+}
+
 BIT radioCrcPassed()
 {
     return (LQI & 0x80) ? 1 : 0;
@@ -109,5 +164,5 @@ uint8 radioLqi()
 
 int8 radioRssi()
 {
-    return ((int8)RSSI)/2 - RSSI_OFFSET;
+    return ((int8)RSSI)/2 - radioRssiOffset;
 }
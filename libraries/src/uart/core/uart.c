@@ -5,6 +5,7 @@
 
 #include <cc2511_map.h>
 #include <cc2511_types.h>
+#include <dma.h>
 
 #if defined(__CDT_PARSER__)
 #define UART0
@@ -24,6 +25,7 @@
 #define UNBAUD                      U0BAUD
 #define UNDBUF                      U0DBUF
 #define BV_UTXNIE                   (1<<2)
+#define UTXN_DMA_TRIGGER            15   // DMA trigger: UTX0 (14 is URX0)
 #define uartNRxParityErrorOccurred  uart0RxParityErrorOccurred
 #define uartNRxFramingErrorOccurred uart0RxFramingErrorOccurred
 #define uartNRxBufferFullOccurred   uart0RxBufferFullOccurred
@@ -37,6 +39,9 @@
 #define uartNRxReceiveByte          uart0RxReceiveByte
 #define uartNTxSend                 uart0TxSend
 #define uartNTxSendByte             uart0TxSendByte
+#define uartNTxSendPacket           uart0TxSendPacket
+#define uartNTxPacketPending        uart0TxPacketPending
+#define uartNTxDmaEnable            uart0TxDmaEnable
 
 #elif defined(UART1)
 #include <uart1.h>
@@ -52,6 +57,7 @@
 #define UNBAUD                      U1BAUD
 #define UNDBUF                      U1DBUF
 #define BV_UTXNIE                   (1<<3)
+#define UTXN_DMA_TRIGGER            17   // DMA trigger: UTX1 (16 is URX1)
 #define uartNRxParityErrorOccurred  uart1RxParityErrorOccurred
 #define uartNRxFramingErrorOccurred uart1RxFramingErrorOccurred
 #define uartNRxBufferFullOccurred   uart1RxBufferFullOccurred
@@ -65,14 +71,38 @@
 #define uartNRxReceiveByte          uart1RxReceiveByte
 #define uartNTxSend                 uart1TxSend
 #define uartNTxSendByte             uart1TxSendByte
+#define uartNTxSendPacket           uart1TxSendPacket
+#define uartNTxPacketPending        uart1TxPacketPending
+#define uartNTxDmaEnable            uart1TxDmaEnable
 #endif
 
 static volatile uint8 XDATA uartTxBuffer[256];         // sizeof(uartTxBuffer) must be a power of two
 static volatile uint8 DATA uartTxBufferMainLoopIndex;  // Index of next byte main loop will write.
 static volatile uint8 DATA uartTxBufferInterruptIndex; // Index of next byte interrupt will read.
 
+// A packet that the ISR sends straight from the caller's buffer (see uartNTxSendPacket).
+// It is sent when uartTxBufferInterruptIndex reaches uartTxPacketMark, so the bytes that
+// were added to uartTxBuffer before it go out first.
+static const uint8 XDATA * DATA uartTxPacket;
+static volatile uint8 DATA uartTxPacketSize;       // The number of bytes of the packet left to send (0 = none).
+static uint8 DATA uartTxPacketMark;
+
 #define UART_TX_BUFFER_FREE_BYTES() ((uartTxBufferInterruptIndex - uartTxBufferMainLoopIndex - 1) & (sizeof(uartTxBuffer) - 1))
 
+// In DMA mode (see uartNTxDmaEnable), the bytes are sent by DMA channel DMA_CHANNEL_UART
+// in spans: each span is either the packet or a contiguous part of uartTxBuffer that
+// stops at the end of the buffer, so wrapping around takes two spans.  When a span is
+// done, the DMA interrupt starts the next one.
+static volatile BIT uartTxDmaMode;
+static volatile BIT uartTxDmaFromPacket;      // 1 if the current span is the packet.
+static volatile uint8 DATA uartTxDmaLength;   // The length of the current span (0 = none).
+
+// Spans of uartNTxSend at least this long are copied with dmaCopy instead of a loop.
+#define DMA_COPY_THRESHOLD  8
+
+// Defined in uart_dma.c, which has the DMA interrupt.
+extern void (*uartDmaHandler)(void);
+
 static volatile uint8 XDATA uartRxBuffer[256];     // sizeof(uartRxBuffer) must be a power of two
 static volatile uint8 DATA uartRxBufferMainLoopIndex;  // Index of next byte main loop will read.
 static volatile uint8 DATA uartRxBufferInterruptIndex; // Index of next byte interrupt will write.
@@ -98,6 +128,9 @@ void uartNInit(void)
 
     uartTxBufferMainLoopIndex = 0;
     uartTxBufferInterruptIndex = 0;
+    uartTxPacketSize = 0;
+    uartTxDmaMode = 0;
+    uartTxDmaLength = 0;
     uartRxBufferMainLoopIndex = 0;
     uartRxBufferInterruptIndex = 0;
     uartNRxParityErrorOccurred = 0;
@@ -205,25 +238,157 @@ void uartNSetStopBits(uint8 stopBits)
     }
 }
 
+// Sets up the DMA channel to send the next span, if there is anything to send.
+// This must be called with the DMA interrupt disabled (or from it).
+static void uartTxDmaStart()
+{
+    const uint8 XDATA * source;
+    uint8 end;
+
+    if (uartTxPacketSize && uartTxBufferInterruptIndex == uartTxPacketMark)
+    {
+        source = uartTxPacket;
+        uartTxDmaLength = uartTxPacketSize;
+        uartTxDmaFromPacket = 1;
+    }
+    else if (uartTxBufferInterruptIndex != uartTxBufferMainLoopIndex)
+    {
+        // The bytes before the packet (if any) have to go first.
+        end = uartTxPacketSize ? uartTxPacketMark : uartTxBufferMainLoopIndex;
+        source = &uartTxBuffer[uartTxBufferInterruptIndex];
+        if (end > uartTxBufferInterruptIndex)
+        {
+            uartTxDmaLength = end - uartTxBufferInterruptIndex;
+        }
+        else
+        {
+            uartTxDmaLength = sizeof(uartTxBuffer) - uartTxBufferInterruptIndex;
+        }
+        uartTxDmaFromPacket = 0;
+    }
+    else
+    {
+        return;
+    }
+
+    dmaConfig.uart.SRCADDRH = (uint16)source >> 8;
+    dmaConfig.uart.SRCADDRL = (uint16)source;
+    dmaConfig.uart.DESTADDRH = XDATA_SFR_ADDRESS(UNDBUF) >> 8;
+    dmaConfig.uart.DESTADDRL = XDATA_SFR_ADDRESS(UNDBUF);
+    dmaConfig.uart.VLEN_LENH = 0;  // Transfer length is fixed (VLEN = 0).
+    dmaConfig.uart.LENL = uartTxDmaLength;
+    dmaConfig.uart.DC6 = UTXN_DMA_TRIGGER; // WORDSIZE = 0, TMODE = 0 (single), TRIG = UTXN
+    dmaConfig.uart.DC7 = 0x48; // SRCINC = 1, DESTINC = 0, IRQMASK = 1, M8 = 0, PRIORITY = 0
+
+    DMAARM |= (1<<DMA_CHANNEL_UART);
+
+    // The channel takes a few clock cycles to load its configuration.
+    __asm nop __endasm;
+    __asm nop __endasm;
+    __asm nop __endasm;
+    __asm nop __endasm;
+    __asm nop __endasm;
+    __asm nop __endasm;
+    __asm nop __endasm;
+    __asm nop __endasm;
+    __asm nop __endasm;
+
+    if (!(UNCSR & 0x01)) // UNCSR.ACTIVE (0) == 0
+    {
+        // The UART is idle, so there will be no TX trigger until we send the first byte.
+        DMAREQ = (1<<DMA_CHANNEL_UART);
+    }
+}
+
+// Called by the DMA interrupt when the current span has been sent.
+static void uartTxDmaDone()
+{
+    if (uartTxDmaFromPacket)
+    {
+        uartTxPacketSize = 0;
+    }
+    else
+    {
+        uartTxBufferInterruptIndex = (uartTxBufferInterruptIndex + uartTxDmaLength) & (sizeof(uartTxBuffer) - 1);
+    }
+    uartTxDmaLength = 0;
+
+    uartTxDmaStart();
+}
+
+// Makes sure the bytes that were just added will be sent.
+static void uartTxStart()
+{
+    if (!uartTxDmaMode)
+    {
+        IEN2 |= BV_UTXNIE; // Enable TX interrupt
+        return;
+    }
+
+    DMAIE = 0;
+    if (uartTxDmaLength == 0)
+    {
+        uartTxDmaStart();
+    }
+    else if (!(UNCSR & 0x01) && (DMAARM & (1<<DMA_CHANNEL_UART)))
+    {
+        // A span is waiting for a TX trigger, but the UART is idle, so the
+        // DMA interrupt must have been too late to catch the last one.
+        DMAREQ = (1<<DMA_CHANNEL_UART);
+    }
+    DMAIE = 1;
+}
+
+void uartNTxDmaEnable(void)
+{
+    // Assumption: Nothing is being sent yet.
+
+    IEN2 &= ~BV_UTXNIE; // Disable TX interrupt
+    uartDmaHandler = uartTxDmaDone;
+    uartTxDmaMode = 1;
+    DMAIE = 1;
+}
+
 uint8 uartNTxAvailable(void)
 {
+    if (uartTxDmaMode)
+    {
+        uartTxStart();
+    }
     return UART_TX_BUFFER_FREE_BYTES();
 }
 
 void uartNTxSend(const uint8 XDATA * buffer, uint8 size)
 {
-    // Assumption: uartNTxSend() was recently called and it returned a number at least as big as 'size'.
-    // TODO: after DMA memcpy is implemented, use it to make this function faster
+    // Assumption: uartNTxAvailable() was recently called and it returned a number at least as big as 'size'.
 
     while (size)
     {
-        uartTxBuffer[uartTxBufferMainLoopIndex] = *buffer;
+        // The number of bytes we can copy before reaching the end of uartTxBuffer.
+        uint8 span = sizeof(uartTxBuffer) - uartTxBufferMainLoopIndex;
+        if (span == 0 || span > size)
+        {
+            span = size;
+        }
+
+        if (span >= DMA_COPY_THRESHOLD)
+        {
+            dmaCopy((uint8 XDATA *)&uartTxBuffer[uartTxBufferMainLoopIndex], buffer, span);
+        }
+        else
+        {
+            uint8 i;
+            for (i = 0; i < span; i++)
+            {
+                uartTxBuffer[uartTxBufferMainLoopIndex + i] = buffer[i];
+            }
+        }
 
-        buffer++;
-        uartTxBufferMainLoopIndex = (uartTxBufferMainLoopIndex + 1) & (sizeof(uartTxBuffer) - 1);
-        size--;
+        buffer += span;
+        uartTxBufferMainLoopIndex = (uartTxBufferMainLoopIndex + span) & (sizeof(uartTxBuffer) - 1);
+        size -= span;
 
-        IEN2 |= BV_UTXNIE; // Enable TX interrupt
+        uartTxStart();
     }
 }
 
@@ -234,7 +399,33 @@ void uartNTxSendByte(uint8 byte)
     uartTxBuffer[uartTxBufferMainLoopIndex] = byte;
     uartTxBufferMainLoopIndex = (uartTxBufferMainLoopIndex + 1) & (sizeof(uartTxBuffer) - 1);
 
-    IEN2 |= BV_UTXNIE; // Enable TX interrupt
+    uartTxStart();
+}
+
+void uartNTxSendPacket(const uint8 XDATA * buffer, uint8 size)
+{
+    // Assumption: uartNTxPacketPending() was recently called and it returned 0.
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    // The ISR ignores the other variables while uartTxPacketSize is 0, so set it last.
+    uartTxPacket = buffer;
+    uartTxPacketMark = uartTxBufferMainLoopIndex;
+    uartTxPacketSize = size;
+
+    uartTxStart();
+}
+
+uint8 uartNTxPacketPending(void)
+{
+    if (uartTxDmaMode)
+    {
+        uartTxStart();
+    }
+    return uartTxPacketSize;
 }
 
 uint8 uartNRxAvailable(void)
@@ -256,7 +447,18 @@ ISR_UTX()
     // A byte has just started transmitting on TX and there is room in
     // the UART's hardware buffer for us to add another byte.
 
-    if (uartTxBufferInterruptIndex != uartTxBufferMainLoopIndex)
+    if (uartTxPacketSize && uartTxBufferInterruptIndex == uartTxPacketMark)
+    {
+        // The bytes that were in the buffer before the packet have been sent,
+        // so send the next byte of the packet.
+
+        UTXNIF = 0;
+
+        UNDBUF = *uartTxPacket;
+        uartTxPacket++;
+        uartTxPacketSize--;
+    }
+    else if (uartTxBufferInterruptIndex != uartTxBufferMainLoopIndex)
     {
         // There more bytes available in our software buffer, so send
         // the next byte.
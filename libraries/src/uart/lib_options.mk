@@ -1,5 +1,5 @@
-# This library will be made by linking uart0.rel and uart1.rel.
-LIB_RELS := libraries/src/uart/uart0.rel libraries/src/uart/uart1.rel
+# This library will be made by linking uart0.rel, uart1.rel, and uart_dma.rel.
+LIB_RELS := libraries/src/uart/uart0.rel libraries/src/uart/uart1.rel libraries/src/uart/uart_dma.rel
 
 # When those rel (object) files are compiled, there will be a
 # special preprocessor flag to specify which UART to use.
@@ -0,0 +1,26 @@
+/* uart_dma.c:
+ *  The DMA interrupt for uart.lib.  Only one UART can send with DMA at a time, because
+ *  there is only one spare DMA channel (DMA_CHANNEL_UART), so uart0TxDmaEnable() and
+ *  uart1TxDmaEnable() just tell this interrupt which UART to call.  This is a separate
+ *  file so that an app can use both UARTs without defining the interrupt twice.
+ */
+
+#include <cc2511_map.h>
+#include <cc2511_types.h>
+#include <dma.h>
+
+void (*uartDmaHandler)(void) = 0;
+
+ISR(DMA, 0)
+{
+    DMAIF = 0;
+
+    if (DMAIRQ & (1<<DMA_CHANNEL_UART))
+    {
+        DMAIRQ &= ~(1<<DMA_CHANNEL_UART);
+        if (uartDmaHandler)
+        {
+            uartDmaHandler();
+        }
+    }
+}